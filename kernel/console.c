@@ -17,6 +17,9 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "file.h"
+#include "waitq.h"
+#include "poll.h"
+#include "fcntl.h"
 #include "memlayout.h"
 #include "riscv.h"
 #include "defs.h"
@@ -50,6 +53,8 @@ struct {
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+
+  struct waitq wq;  // poll()ers waiting for a line
 } cons;
 
 //
@@ -58,13 +63,18 @@ struct {
 int
 consolewrite(int user_src, uint64 src, int n)
 {
-  int i;
-
-  for(i = 0; i < n; i++){
-    char c;
-    if(either_copyin(&c, user_src, src+i, 1) == -1)
+  char buf[128];
+  int i, m;
+
+  // copy in a chunk at a time, and hand each chunk to
+  // the uart in one go.
+  for(i = 0; i < n; i += m){
+    m = n - i;
+    if(m > sizeof(buf))
+      m = sizeof(buf);
+    if(either_copyin(buf, user_src, src+i, m) == -1)
       break;
-    uartputc(c);
+    uartwrite(buf, m);
   }
 
   return i;
@@ -74,10 +84,11 @@ consolewrite(int user_src, uint64 src, int n)
 // user read()s from the console go here.
 // copy (up to) a whole input line to dst.
 // user_dist indicates whether dst is a user
-// or kernel address.
+// or kernel address. if nonblock, return -EAGAIN
+// rather than waiting for a line.
 //
 int
-consoleread(int user_dst, uint64 dst, int n)
+consoleread(int user_dst, uint64 dst, int n, int nonblock)
 {
   uint target;
   int c;
@@ -93,6 +104,10 @@ consoleread(int user_dst, uint64 dst, int n)
         release(&cons.lock);
         return -1;
       }
+      if(nonblock){
+        release(&cons.lock);
+        return -EAGAIN;
+      }
       sleep(&cons.r, &cons.lock);
     }
 
@@ -170,6 +185,7 @@ consoleintr(int c)
         // has arrived.
         cons.w = cons.e;
         wakeup(&cons.r);
+        wakeq(&cons.wq);
       }
     }
     break;
@@ -178,10 +194,26 @@ consoleintr(int c)
   release(&cons.lock);
 }
 
+// poll() the console: readable once a whole line (or
+// end-of-file) has arrived; writes never wait for long.
+int
+consolepoll(struct pollent *e)
+{
+  int ev = POLLOUT;
+
+  acquire(&cons.lock);
+  pollwait(&cons.wq, e);
+  if(cons.r != cons.w)
+    ev |= POLLIN;
+  release(&cons.lock);
+  return ev;
+}
+
 void
 consoleinit(void)
 {
   initlock(&cons.lock, "cons");
+  initwaitq(&cons.wq, "conswq");
 
   uartinit();
 
@@ -189,4 +221,5 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].poll = consolepoll;
 }
@@ -2,12 +2,19 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct iovec;
 struct pipe;
+struct shm;
+struct pollent;
 struct proc;
+struct rwlock;
+struct seqlock;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct utime;
+struct waitq;
 
 // bio.c
 void            binit(void);
@@ -29,22 +36,32 @@ int             exec(char*, char**);
 struct file*    filealloc(void);
 void            fileclose(struct file*);
 struct file*    filedup(struct file*);
-void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filereadv(struct file*, struct iovec*, int);
+int             filewritev(struct file*, struct iovec*, int);
+int             filepread(struct file*, uint64, int n, uint);
+int             filepwrite(struct file*, uint64, int n, uint);
+int             fileseek(struct file*, int, int);
+int             filesplice(struct file*, struct file*, int);
+int             filepoll(struct file*, struct pollent*);
 
 // fs.c
 void            fsinit(int);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+void            dcacheadd(struct inode*, char*, uint);
+void            dcacheremove(struct inode*, char*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
 void            ilock(struct inode*);
+void            ilockshared(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
+void            iunlockshared(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
@@ -63,6 +80,9 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kalloc_mega(void);
+void            kfree_mega(void *);
+int             kdup(void *);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -73,22 +93,48 @@ void            end_op(void);
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             piperead(struct pipe*, int, uint64, int, int);
+int             pipewrite(struct pipe*, int, uint64, int, int);
+int             pipepoll(struct pipe*, int, struct pollent*);
+int             pipespace(struct pipe*);
+
+// shm.c
+struct shm*     shmalloc(uint64);
+void            shmfree(struct shm*);
+uint64          shmmap(struct shm*);
+
+// poll.c
+void            initwaitq(struct waitq*, char*);
+void            pollwait(struct waitq*, struct pollent*);
+void            pollunwait(struct pollent*);
+void            wakeq(struct waitq*);
+void            pollarm(void);
+int             pollsleep(void);
 
 // printf.c
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
+void            logdrain(void);
+int             logread(uint64, int);
 
 // proc.c
+void            asidinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
+int             growproc(int, uint64*);
+uint64          growshared(uint64*, int);
+int             clone(uint64, uint64, uint64);
+int             futexwait(uint64, int);
+int             futexwake(uint64, int);
+int             growfds(struct proc*);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
+uint64          proc_asid(struct proc *);
+uint64          proc_ksatp(struct proc *, uint64);
+void            proc_flushasid(struct proc *);
 int             kill(int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
@@ -107,6 +153,10 @@ int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 
+// copyuser.S
+int             copyuser(void*, const void*, uint64);
+int             copyuserstr(char*, const char*, uint64);
+
 // swtch.S
 void            swtch(struct context*, struct context*);
 
@@ -114,13 +164,39 @@ void            swtch(struct context*, struct context*);
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initticketlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+void            freelock(struct spinlock*);
+int             lockstats(uint64, int);
+
+// rcu.c
+void            rcureadlock(void);
+void            rcureadunlock(void);
+void            rcuquiescent(void);
+void            rcusnap(uint64*);
+int             rcupassed(uint64*);
+
+// rwlock.c
+void            acquireread(struct rwlock*);
+void            acquirewrite(struct rwlock*);
+void            initrwlock(struct rwlock*, char*);
+void            releaseread(struct rwlock*);
+void            releasewrite(struct rwlock*);
+
+// seqlock.c
+void            initseqlock(struct seqlock*, char*);
+uint            seqbegin(struct seqlock*);
+int             seqretry(struct seqlock*, uint);
+void            seqwritebegin(struct seqlock*);
+void            seqwriteend(struct seqlock*);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
+void            releasesleepshared(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
@@ -143,33 +219,53 @@ void            syscall();
 
 // trap.c
 extern uint     ticks;
+extern struct utime *utime;
 void            trapinit(void);
 void            trapinithart(void);
+void            clockintr(void);
 extern struct spinlock tickslock;
+extern struct seqlock tickseq;
+extern struct waitq tickwq;
 void            usertrapret(void);
 
+// timer.c
+void            timerqinit(void);
+void            timerintr(void);
+void            timerarm(void);
+void            timerslice(void);
+void            kickidle(void);
+int             timersleep(uint64);
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
 void            uartputc_sync(int);
+void            uartwrite(char*, int);
+int             uarttrywrite(char*, int);
 int             uartgetc(void);
 
 // vm.c
 void            kvminit(void);
 void            kvminithart(void);
+pagetable_t     kvmcreate(void);
+void            kvmmapuser(pagetable_t, pagetable_t);
+void            kvmfree(pagetable_t);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
+int             mapmegapages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 void            uvmfirst(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
+int             uvmsplit(pagetable_t, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
+uint64          walkaddrw(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
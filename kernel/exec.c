@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
@@ -31,6 +32,10 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // other threads would be left running in the old memory.
+  if(p->leader != p || p->nthread > 1)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -83,6 +88,10 @@ exec(char *path, char **argv)
   if((sz1 = uvmalloc(pagetable, sz, sz + 2*PGSIZE, PTE_W)) == 0)
     goto bad;
   sz = sz1;
+#ifdef KVMUSER
+  if(sz > MAXUVA)
+    goto bad;
+#endif
   uvmclear(pagetable, sz-2*PGSIZE);
   sp = sz;
   stackbase = sp - PGSIZE;
@@ -124,6 +133,10 @@ exec(char *path, char **argv)
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
+#ifdef KVMUSER
+  kvmmapuser(p->kpagetable, p->pagetable);
+#endif
+  proc_flushasid(p);
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
@@ -3,3 +3,17 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+#define O_NONBLOCK 0x800
+
+// fcntl() commands
+#define F_GETFL   3  // get O_ mode and O_NONBLOCK
+#define F_SETFL   4  // set O_NONBLOCK from arg
+
+// returned, negated, by read() or write() on an O_NONBLOCK
+// descriptor that would otherwise have had to wait.
+#define EAGAIN    11
+
+// lseek() whence
+#define SEEK_SET  0
+#define SEEK_CUR  1
+#define SEEK_END  2
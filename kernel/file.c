@@ -10,48 +10,57 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "fcntl.h"
+#include "poll.h"
+#include "uio.h"
 #include "stat.h"
 #include "proc.h"
 
 struct devsw devsw[NDEV];
-struct {
-  struct spinlock lock;
-  struct file file[NFILE];
-} ftable;
 
-void
-fileinit(void)
-{
-  initlock(&ftable.lock, "ftable");
-}
+// There is no fixed file table. Files are carved out of pages
+// from kalloc() as needed, and kept on per-CPU free lists, so
+// that filealloc() and fileclose() take no shared lock; f->ref
+// is changed with atomic instructions. Pages of files are
+// never given back.
+static struct {
+  struct file *free;
+} fcache[NCPU];
 
 // Allocate a file structure.
 struct file*
 filealloc(void)
 {
-  struct file *f;
+  struct file *f, *p;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
+  push_off();
+  f = fcache[cpuid()].free;
+  if(f == 0 && (p = kalloc()) != 0){
+    // this CPU is out; carve up a new page.
+    for(f = p; f < p + PGSIZE/sizeof(*f); f++){
+      f->next = fcache[cpuid()].free;
+      fcache[cpuid()].free = f;
     }
+    f = fcache[cpuid()].free;
   }
-  release(&ftable.lock);
-  return 0;
+  if(f)
+    fcache[cpuid()].free = f->next;
+  pop_off();
+
+  if(f == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->type = FD_NONE;
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
 struct file*
 filedup(struct file *f)
 {
-  acquire(&ftable.lock);
-  if(f->ref < 1)
+  if(__sync_fetch_and_add(&f->ref, 1) < 1)
     panic("filedup");
-  f->ref++;
-  release(&ftable.lock);
   return f;
 }
 
@@ -60,18 +69,19 @@ void
 fileclose(struct file *f)
 {
   struct file ff;
+  int ref;
 
-  acquire(&ftable.lock);
-  if(f->ref < 1)
-    panic("fileclose");
-  if(--f->ref > 0){
-    release(&ftable.lock);
+  if((ref = __sync_sub_and_fetch(&f->ref, 1)) > 0)
     return;
-  }
+  if(ref < 0)
+    panic("fileclose");
   ff = *f;
-  f->ref = 0;
   f->type = FD_NONE;
-  release(&ftable.lock);
+
+  push_off();
+  f->next = fcache[cpuid()].free;
+  fcache[cpuid()].free = f;
+  pop_off();
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
@@ -79,6 +89,8 @@ fileclose(struct file *f)
     begin_op();
     iput(ff.ip);
     end_op();
+  } else if(ff.type == FD_SHM){
+    shmfree(ff.shm);
   }
 }
 
@@ -102,9 +114,10 @@ filestat(struct file *f, uint64 addr)
 }
 
 // Read from file f.
-// addr is a user virtual address.
-int
-fileread(struct file *f, uint64 addr, int n)
+// addr is a user virtual address if user_dst==1,
+// or a kernel address otherwise.
+static int
+readfile(struct file *f, int user_dst, uint64 addr, int n)
 {
   int r = 0;
 
@@ -112,14 +125,14 @@ fileread(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    r = piperead(f->pipe, addr, n);
+    r = piperead(f->pipe, user_dst, addr, n, f->nonblock);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
       return -1;
-    r = devsw[f->major].read(1, addr, n);
+    r = devsw[f->major].read(user_dst, addr, n, f->nonblock);
   } else if(f->type == FD_INODE){
     ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
+    if((r = readi(f->ip, user_dst, addr, f->off, n)) > 0)
       f->off += r;
     iunlock(f->ip);
   } else {
@@ -129,54 +142,331 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
-// Write to file f.
+// Read from file f.
 // addr is a user virtual address.
 int
-filewrite(struct file *f, uint64 addr, int n)
+fileread(struct file *f, uint64 addr, int n)
+{
+  return readfile(f, 1, addr, n);
+}
+
+// Write n bytes at addr to inode ip at *off, advancing *off,
+// which the inode lock protects. addr is a user virtual address
+// if user_src==1, or a kernel address otherwise.
+static int
+writeinode(struct inode *ip, int user_src, uint64 addr, int n, uint *off)
+{
+  int r;
+
+  // write a few blocks at a time to avoid exceeding
+  // the maximum log transaction size, including
+  // i-node, indirect block, allocation blocks,
+  // and 2 blocks of slop for non-aligned writes.
+  // this really belongs lower down, since writei()
+  // might be writing a device like the console.
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  int i = 0;
+  while(i < n){
+    int n1 = n - i;
+    if(n1 > max)
+      n1 = max;
+
+    begin_op();
+    ilock(ip);
+    if ((r = writei(ip, user_src, addr + i, *off, n1)) > 0)
+      *off += r;
+    iunlock(ip);
+    end_op();
+
+    if(r != n1){
+      // error from writei
+      break;
+    }
+    i += r;
+  }
+  return i == n ? n : -1;
+}
+
+// Write to file f.
+// addr is a user virtual address if user_src==1,
+// or a kernel address otherwise.
+static int
+writefile(struct file *f, int user_src, uint64 addr, int n)
 {
-  int r, ret = 0;
+  int ret = 0;
 
   if(f->writable == 0)
     return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewrite(f->pipe, user_src, addr, n, f->nonblock);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
       return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    ret = devsw[f->major].write(user_src, addr, n);
   } else if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_op();
-      ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
+    ret = writeinode(f->ip, user_src, addr, n, &f->off);
+  } else {
+    panic("filewrite");
+  }
+
+  return ret;
+}
+
+// Write to file f.
+// addr is a user virtual address.
+int
+filewrite(struct file *f, uint64 addr, int n)
+{
+  return writefile(f, 1, addr, n);
+}
+
+// Read from file f into the n buffers described by iov, in order,
+// stopping early at a short read. The iov_base are user virtual
+// addresses. Returns the bytes read, or -1 if nothing could be.
+int
+filereadv(struct file *f, struct iovec *iov, int n)
+{
+  int i, r, tot;
+
+  if(f->readable == 0)
+    return -1;
+
+  r = tot = 0;
+  if(f->type == FD_INODE){
+    // one ilock() for all the pieces.
+    ilock(f->ip);
+    for(i = 0; i < n; i++){
+      r = readi(f->ip, 1, (uint64)iov[i].iov_base, f->off, iov[i].iov_len);
+      if(r > 0){
         f->off += r;
-      iunlock(f->ip);
-      end_op();
+        tot += r;
+      }
+      if(r != iov[i].iov_len)
+        break;
+    }
+    iunlock(f->ip);
+    if(r < 0 && tot == 0)
+      return -1;
+    return tot;
+  }
+
+  // a pipe or device, which may have nothing more to
+  // read; like read(), return once some data has arrived.
+  for(i = 0; i < n; i++){
+    if(iov[i].iov_len == 0)
+      continue;
+    return fileread(f, (uint64)iov[i].iov_base, iov[i].iov_len);
+  }
+  return 0;
+}
 
+// Write the n buffers described by iov to file f, in order.
+// Returns the total bytes written, or -1 if they couldn't all be.
+int
+filewritev(struct file *f, struct iovec *iov, int n)
+{
+  int i, r, tot, want, n1, budget;
+  uint64 done;
+
+  if(f->writable == 0)
+    return -1;
+
+  want = 0;
+  for(i = 0; i < n; i++)
+    want += iov[i].iov_len;
+
+  if(f->type != FD_INODE){
+    tot = 0;
+    for(i = 0; i < n; i++){
+      // a short write, from an O_NONBLOCK pipe say,
+      // ends the call.
+      if((r = filewrite(f, (uint64)iov[i].iov_base, iov[i].iov_len)) < 0)
+        return tot > 0 ? tot : r;
+      tot += r;
+      if(r != iov[i].iov_len)
+        break;
+    }
+    return tot;
+  }
+
+  // like filewrite(), but the pieces go to consecutive file
+  // offsets, so as many of them as fit in filewrite()'s limit
+  // can share a log transaction.
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  tot = 0;
+  i = 0;
+  done = 0;  // bytes of iov[i] already written
+  while(i < n){
+    begin_op();
+    ilock(f->ip);
+    for(budget = max; i < n && budget > 0; budget -= n1){
+      n1 = iov[i].iov_len - done;
+      if(n1 > budget)
+        n1 = budget;
+      if((r = writei(f->ip, 1, (uint64)iov[i].iov_base + done, f->off, n1)) > 0){
+        f->off += r;
+        tot += r;
+      }
       if(r != n1){
         // error from writei
+        i = n;
         break;
       }
-      i += r;
+      done += n1;
+      if(done == iov[i].iov_len){
+        i++;
+        done = 0;
+      }
     }
-    ret = (i == n ? n : -1);
-  } else {
-    panic("filewrite");
+    iunlock(f->ip);
+    end_op();
   }
+  return tot == want ? tot : -1;
+}
 
-  return ret;
+// Read from file f at offset off, leaving f->off alone.
+// Only inodes have offsets. Readers share the inode lock,
+// so they can work on the same file at the same time.
+int
+filepread(struct file *f, uint64 addr, int n, uint off)
+{
+  int r;
+
+  if(f->readable == 0 || f->type != FD_INODE)
+    return -1;
+
+  ilockshared(f->ip);
+  r = readi(f->ip, 1, addr, off, n);
+  iunlockshared(f->ip);
+  return r;
+}
+
+// Write to file f at offset off, leaving f->off alone.
+int
+filepwrite(struct file *f, uint64 addr, int n, uint off)
+{
+  if(f->writable == 0 || f->type != FD_INODE)
+    return -1;
+  return writeinode(f->ip, 1, addr, n, &off);
 }
 
+// Set f's offset relative to whence (SEEK_SET, SEEK_CUR or
+// SEEK_END). Since writei() can't leave a hole, the new offset
+// must lie within the file. Returns the new offset.
+int
+fileseek(struct file *f, int off, int whence)
+{
+  int base;
+
+  if(f->type != FD_INODE)
+    return -1;
+
+  ilock(f->ip);
+  if(whence == SEEK_SET)
+    base = 0;
+  else if(whence == SEEK_CUR)
+    base = f->off;
+  else if(whence == SEEK_END)
+    base = f->ip->size;
+  else
+    base = -1;
+  if(base < 0 || base + off < 0 || base + off > f->ip->size){
+    iunlock(f->ip);
+    return -1;
+  }
+  f->off = base + off;
+  iunlock(f->ip);
+  return f->off;
+}
+
+// Move up to n bytes from file in to file out inside the kernel,
+// through a page-sized buffer rather than user memory. Inodes
+// are read and written at their offsets. A pipe or device is
+// read once, since it may have nothing more to give.
+// Nothing is taken from in that out can't accept.
+// Returns the bytes moved, or -1 if none could be.
+int
+filesplice(struct file *in, struct file *out, int n)
+{
+  char *buf;
+  int m, r, w, tot;
+
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+  if((buf = kalloc()) == 0)
+    return -1;
+
+  tot = 0;
+  while(tot < n){
+    m = n - tot < PGSIZE ? n - tot : PGSIZE;
+    if(out->type == FD_PIPE && out->nonblock){
+      // read no more than an O_NONBLOCK out can take now.
+      if((w = pipespace(out->pipe)) <= 0){
+        if(tot == 0)
+          tot = w < 0 ? -1 : -EAGAIN;
+        break;
+      }
+      if(m > w)
+        m = w;
+    }
+
+    if(in->type == FD_INODE){
+      // read at in->off but advance it below only by what
+      // out takes, so a short write needn't rewind it.
+      ilock(in->ip);
+      r = readi(in->ip, 0, (uint64)buf, in->off, m);
+      iunlock(in->ip);
+    } else {
+      r = readfile(in, 0, (uint64)buf, m);
+    }
+    if(r <= 0){
+      if(r < 0 && tot == 0)
+        tot = r;
+      break;
+    }
+
+    w = writefile(out, 0, (uint64)buf, r);
+    if(w == -EAGAIN)
+      w = 0;
+    if(w >= 0 && w < r && in->type != FD_INODE && out->type == FD_PIPE){
+      // another writer filled out after pipespace(). what a
+      // pipe or device gave up can't go back, so wait for room.
+      if((m = pipewrite(out->pipe, 0, (uint64)buf + w, r - w, 0)) > 0)
+        w += m;
+    }
+    if(w > 0 && in->type == FD_INODE){
+      ilock(in->ip);
+      in->off += w;
+      iunlock(in->ip);
+    }
+    if(w != r){
+      if(w > 0)
+        tot += w;
+      else if(tot == 0)
+        tot = w < 0 ? w : -EAGAIN;
+      break;
+    }
+    tot += r;
+    if(in->type != FD_INODE)
+      break;
+  }
+
+  kfree(buf);
+  return tot;
+}
+
+// Return the poll() events ready on f, first putting the
+// current process on f's wait queue with e, unless e is 0.
+int
+filepoll(struct file *f, struct pollent *e)
+{
+  if(f->type == FD_PIPE)
+    return pipepoll(f->pipe, f->writable, e);
+  if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV && devsw[f->major].poll)
+    return devsw[f->major].poll(e);
+
+  // inodes, and devices that can't tell, never make
+  // read() or write() wait.
+  return (f->readable ? POLLIN : 0) | (f->writable ? POLLOUT : 0);
+}
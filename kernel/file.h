@@ -1,12 +1,15 @@
 struct file {
-  enum { FD_NONE, FD_PIPE, FD_INODE, FD_DEVICE } type;
-  int ref; // reference count
+  enum { FD_NONE, FD_PIPE, FD_INODE, FD_DEVICE, FD_SHM } type;
+  int ref; // reference count, changed atomically
+  struct file *next; // on a per-CPU free list
   char readable;
   char writable;
+  char nonblock;     // O_NONBLOCK: read() and write() don't wait
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
   short major;       // FD_DEVICE
+  struct shm *shm;   // FD_SHM
 };
 
 #define major(dev)  ((dev) >> 16 & 0xFFFF)
@@ -29,10 +32,13 @@ struct inode {
   uint addrs[NDIRECT+1];
 };
 
+struct pollent;
+
 // map major device number to device functions.
 struct devsw {
-  int (*read)(int, uint64, int);
+  int (*read)(int, uint64, int, int);  // last arg is nonblock
   int (*write)(int, uint64, int);
+  int (*poll)(struct pollent*);  // optional; see filepoll()
 };
 
 extern struct devsw devsw[];
@@ -15,8 +15,9 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
-#include "proc.h"
+#include "rwlock.h"
 #include "sleeplock.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
@@ -164,33 +165,40 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
+// The itable.lock reader-writer lock protects the allocation of
+// itable entries. Since ip->ref indicates whether an entry is
+// free, and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold itable.lock while using any of those fields.
+// Holding it for reading is enough to look entries up and to
+// change ip->ref atomically, as long as ref doesn't drop to 0;
+// recycling an entry or dropping the last reference needs it
+// for writing.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
 struct {
-  struct spinlock lock;
+  struct rwlock lock;
   struct inode inode[NINODE];
 } itable;
 
+static struct inode* iget(uint dev, uint inum);
+static void dcacheinit(void);
+static void dcachepurge(uint dev, uint inum);
+
 void
 iinit()
 {
   int i = 0;
   
-  initlock(&itable.lock, "itable");
+  initrwlock(&itable.lock, "itable");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
+  dcacheinit();
 }
 
-static struct inode* iget(uint dev, uint inum);
-
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
 // Returns an unlocked but allocated and referenced inode,
@@ -248,21 +256,31 @@ iget(uint dev, uint inum)
 {
   struct inode *ip, *empty;
 
-  acquire(&itable.lock);
-
   // Is the inode already in the table?
+  acquireread(&itable.lock);
+  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
+    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+      __sync_fetch_and_add(&ip->ref, 1);
+      releaseread(&itable.lock);
+      return ip;
+    }
+  }
+  releaseread(&itable.lock);
+
+  // Look again, since another CPU may have added it,
+  // and recycle an empty entry if not.
+  acquirewrite(&itable.lock);
   empty = 0;
   for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
     if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
       ip->ref++;
-      release(&itable.lock);
+      releasewrite(&itable.lock);
       return ip;
     }
     if(empty == 0 && ip->ref == 0)    // Remember empty slot.
       empty = ip;
   }
 
-  // Recycle an inode entry.
   if(empty == 0)
     panic("iget: no inodes");
 
@@ -271,7 +289,7 @@ iget(uint dev, uint inum)
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
-  release(&itable.lock);
+  releasewrite(&itable.lock);
 
   return ip;
 }
@@ -281,9 +299,9 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
-  ip->ref++;
-  release(&itable.lock);
+  acquireread(&itable.lock);
+  __sync_fetch_and_add(&ip->ref, 1);
+  releaseread(&itable.lock);
   return ip;
 }
 
@@ -326,6 +344,32 @@ iunlock(struct inode *ip)
   releasesleep(&ip->lock);
 }
 
+// Lock the given inode shared with other ilockshared() callers,
+// for code that only reads it, such as readi().
+// Reads the inode from disk if necessary.
+void
+ilockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockshared");
+
+  if(ip->valid == 0){
+    // the caller's reference keeps it valid from here on.
+    ilock(ip);
+    iunlock(ip);
+  }
+  acquiresleepshared(&ip->lock);
+}
+
+void
+iunlockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("iunlockshared");
+
+  releasesleepshared(&ip->lock);
+}
+
 // Drop a reference to an in-memory inode.
 // If that was the last reference, the inode table entry can
 // be recycled.
@@ -336,7 +380,20 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&itable.lock);
+  int ref;
+
+  // drop a reference that isn't the last without
+  // excluding other readers.
+  acquireread(&itable.lock);
+  while((ref = ip->ref) > 1){
+    if(__sync_bool_compare_and_swap(&ip->ref, ref, ref-1)){
+      releaseread(&itable.lock);
+      return;
+    }
+  }
+  releaseread(&itable.lock);
+
+  acquirewrite(&itable.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
@@ -345,8 +402,10 @@ iput(struct inode *ip)
     // so this acquiresleep() won't block (or deadlock).
     acquiresleep(&ip->lock);
 
-    release(&itable.lock);
+    releasewrite(&itable.lock);
 
+    if(ip->type == T_DIR)
+      dcachepurge(ip->dev, ip->inum);
     itrunc(ip);
     ip->type = 0;
     iupdate(ip);
@@ -354,11 +413,11 @@ iput(struct inode *ip)
 
     releasesleep(&ip->lock);
 
-    acquire(&itable.lock);
+    acquirewrite(&itable.lock);
   }
 
   ip->ref--;
-  release(&itable.lock);
+  releasewrite(&itable.lock);
 }
 
 // Common idiom: unlock, then put.
@@ -605,6 +664,207 @@ dirlink(struct inode *dp, char *name, uint inum)
   return 0;
 }
 
+// Directory entry cache, so that namex() can walk through
+// directories without locking them. Entries map a directory and
+// a name in it to an inode number, and are only ever added by a
+// locked lookup, with the directory locked.
+//
+// Readers search the hash chains under rcureadlock() alone.
+// Writers (adding, or removing for unlink()) hold dcache.lock,
+// fill in an entry before linking it into a chain, and never
+// change an entry or its chain link while it may still be seen:
+// a removed entry is marked dead and retired, and becomes free
+// only after an RCU grace period.
+#define NDENTRY 128
+#define NDHASH  64
+
+struct dentry {
+  struct dentry *next;   // hash chain, followed by readers
+  struct dentry *link;   // free, retired or waiting list
+  uint dev;
+  uint dir;              // inum of the directory
+  uint inum;             // inum that name refers to
+  int dead;              // removed from its chain
+  char name[DIRSIZ];
+};
+
+struct {
+  struct spinlock lock;
+  struct dentry *hash[NDHASH];
+  struct dentry dentry[NDENTRY];
+  struct dentry *free;
+  struct dentry *retired;  // removed since waiting's snapshot
+  struct dentry *waiting;  // removed before snap was taken
+  uint64 snap[NCPU];
+  int victim;              // next entry to evict when full
+} dcache;
+
+static void
+dcacheinit(void)
+{
+  struct dentry *e;
+
+  initlock(&dcache.lock, "dcache");
+  for(e = dcache.dentry; e < &dcache.dentry[NDENTRY]; e++){
+    e->link = dcache.free;
+    dcache.free = e;
+  }
+}
+
+static struct dentry**
+dhash(uint dev, uint dir, char *name)
+{
+  uint h;
+  int i;
+
+  h = dev * 31 + dir;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return &dcache.hash[h % NDHASH];
+}
+
+// unlink e from its chain and retire it.
+// caller holds dcache.lock.
+static void
+dremove(struct dentry *e)
+{
+  struct dentry **pp;
+
+  for(pp = dhash(e->dev, e->dir, e->name); *pp != e; pp = &(*pp)->next)
+    ;
+  *pp = e->next;
+  e->dead = 1;
+  __sync_synchronize();
+  e->link = dcache.retired;
+  dcache.retired = e;
+}
+
+// find a free entry, moving retired entries along towards
+// the free list. caller holds dcache.lock.
+static struct dentry*
+dalloc(void)
+{
+  struct dentry *e;
+
+  if(dcache.free == 0 && dcache.waiting && rcupassed(dcache.snap)){
+    dcache.free = dcache.waiting;
+    dcache.waiting = 0;
+  }
+  if(dcache.waiting == 0 && dcache.retired){
+    dcache.waiting = dcache.retired;
+    dcache.retired = 0;
+    rcusnap(dcache.snap);
+  }
+  if((e = dcache.free) == 0){
+    // full: evict an entry, to be reused once it's safe.
+    e = &dcache.dentry[dcache.victim++ % NDENTRY];
+    if(!e->dead)
+      dremove(e);
+    return 0;
+  }
+  dcache.free = e->link;
+  return e;
+}
+
+// remember that name in directory dp is inode inum.
+// caller holds dp's lock.
+void
+dcacheadd(struct inode *dp, char *name, uint inum)
+{
+  struct dentry *e, **pp;
+
+  acquire(&dcache.lock);
+  pp = dhash(dp->dev, dp->inum, name);
+  for(e = *pp; e; e = e->next){
+    if(e->dev == dp->dev && e->dir == dp->inum && namecmp(e->name, name) == 0){
+      release(&dcache.lock);
+      return;
+    }
+  }
+  if((e = dalloc()) != 0){
+    e->dev = dp->dev;
+    e->dir = dp->inum;
+    e->inum = inum;
+    e->dead = 0;
+    strncpy(e->name, name, DIRSIZ);
+    e->next = *pp;
+    // make the entry's contents visible before the entry.
+    __sync_synchronize();
+    *pp = e;
+  }
+  release(&dcache.lock);
+}
+
+// forget name in directory dp, which is being unlinked.
+// caller holds dp's lock.
+void
+dcacheremove(struct inode *dp, char *name)
+{
+  struct dentry *e;
+
+  acquire(&dcache.lock);
+  for(e = *dhash(dp->dev, dp->inum, name); e; e = e->next){
+    if(e->dev == dp->dev && e->dir == dp->inum && namecmp(e->name, name) == 0){
+      dremove(e);
+      break;
+    }
+  }
+  release(&dcache.lock);
+}
+
+// forget every name in directory inode inum on dev, which is
+// being freed, so that the inum can be reused.
+static void
+dcachepurge(uint dev, uint inum)
+{
+  struct dentry *e;
+  struct dentry *next;
+  int h;
+
+  acquire(&dcache.lock);
+  for(h = 0; h < NDHASH; h++){
+    for(e = dcache.hash[h]; e; e = next){
+      next = e->next;
+      if(e->dev == dev && e->dir == inum)
+        dremove(e);
+    }
+  }
+  release(&dcache.lock);
+}
+
+// look up name in directory dp without locking dp.
+// returns the inode, referenced but not locked, or 0 if
+// name isn't in the cache.
+static struct inode*
+dcachelookup(struct inode *dp, char *name)
+{
+  struct dentry *e;
+  struct inode *ip;
+  int dead;
+
+  ip = 0;
+  dead = 0;
+  rcureadlock();
+  for(e = *(struct dentry * volatile *)dhash(dp->dev, dp->inum, name); e;
+      e = *(struct dentry * volatile *)&e->next){
+    if(e->dev == dp->dev && e->dir == dp->inum && namecmp(e->name, name) == 0){
+      ip = iget(e->dev, e->inum);
+      // if unlink() removed e before iget() took its reference,
+      // the inode may have been freed; use the locked path.
+      __sync_synchronize();
+      dead = e->dead;
+      break;
+    }
+  }
+  rcureadunlock();
+
+  if(ip && dead){
+    iput(ip);
+    ip = 0;
+  }
+  return ip;
+}
+
 // Paths
 
 // Copy the next path element from path into name.
@@ -659,6 +919,15 @@ namex(char *path, int nameiparent, char *name)
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
+    // try the directory entry cache first, unless this
+    // is the parent the caller wants, which must be
+    // checked to be a directory.
+    if(!(nameiparent && *path == '\0') && (next = dcachelookup(ip, name)) != 0){
+      iput(ip);
+      ip = next;
+      continue;
+    }
+
     ilock(ip);
     if(ip->type != T_DIR){
       iunlockput(ip);
@@ -673,6 +942,7 @@ namex(char *path, int nameiparent, char *name)
       iunlockput(ip);
       return 0;
     }
+    dcacheadd(ip, name, next->inum);
     iunlockput(ip);
     ip = next;
   }
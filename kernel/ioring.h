@@ -0,0 +1,37 @@
+// Submission and completion rings shared between a process and
+// the kernel, in one page of the process's memory. The process
+// fills in sq[sqtail % IORING_NSQ] and advances sqtail, then
+// calls ioring_enter(); the kernel consumes entries from sqhead,
+// and posts a result for each at cq[cqtail % IORING_NCQ]. The
+// process consumes results from cqhead.
+#define IORING_NSQ 64
+#define IORING_NCQ 64
+
+#define IORING_OP_READ  1   // read(fd, addr, len)
+#define IORING_OP_WRITE 2   // write(fd, addr, len)
+#define IORING_OP_OPEN  3   // open(addr, len), len is the mode
+#define IORING_OP_CLOSE 4   // close(fd)
+
+struct iosqe {
+  int op;
+  int fd;
+  uint64 addr;
+  int len;
+  int pad;
+  uint64 data;      // copied to the iocqe, for the process
+};
+
+struct iocqe {
+  uint64 data;
+  int res;          // what the system call would have returned
+  int pad;
+};
+
+struct ioring {
+  uint sqhead;      // written by the kernel
+  uint sqtail;      // written by the process
+  uint cqhead;      // written by the process
+  uint cqtail;      // written by the kernel
+  struct iosqe sq[IORING_NSQ];
+  struct iocqe cq[IORING_NCQ];
+};
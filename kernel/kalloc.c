@@ -1,6 +1,7 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// and 2-megabyte megapages for user superpages.
 
 #include "types.h"
 #include "param.h"
@@ -21,13 +22,31 @@ struct run {
 struct {
   struct spinlock lock;
   struct run *freelist;
+  struct run *megalist; // free megapages
 } kmem;
 
+// references to each page beyond the one that kalloc()
+// hands out, taken by kdup() for memory that processes
+// share. kfree() drops one of these if there are any.
+static uint pgref[(PHYSTOP - KERNBASE) / PGSIZE];
+#define PGREF(pa) (&pgref[((uint64)(pa) - KERNBASE) / PGSIZE])
+
 void
 kinit()
 {
-  initlock(&kmem.lock, "kmem");
-  freerange(end, (void*)PHYSTOP);
+  char *p, *megastart;
+
+  initticketlock(&kmem.lock, "kmem");
+
+  // set aside the top NMEGAPG megapages of RAM, which are
+  // physically contiguous and aligned, for kalloc_mega().
+  // kalloc() breaks them up if it runs out of ordinary pages.
+  megastart = (char*)(PHYSTOP - NMEGAPG*MEGAPGSIZE);
+  if(megastart < (char*)MEGAPGROUNDUP((uint64)end))
+    megastart = (char*)MEGAPGROUNDUP((uint64)end);
+  freerange(end, megastart);
+  for(p = megastart; p + MEGAPGSIZE <= (char*)PHYSTOP; p += MEGAPGSIZE)
+    kfree_mega(p);
 }
 
 void
@@ -43,14 +62,21 @@ freerange(void *pa_start, void *pa_end)
 // which normally should have been returned by a
 // call to kalloc().  (The exception is when
 // initializing the allocator; see kinit above.)
+// If kdup() has added references, just drop one.
 void
 kfree(void *pa)
 {
   struct run *r;
+  uint n;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  while((n = *PGREF(pa)) != 0){
+    if(__sync_bool_compare_and_swap(PGREF(pa), n, n - 1))
+      return;
+  }
+
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
 
@@ -71,6 +97,16 @@ kalloc(void)
   struct run *r;
 
   acquire(&kmem.lock);
+  if(kmem.freelist == 0 && kmem.megalist != 0){
+    // out of ordinary pages; split a megapage.
+    char *pa = (char*)kmem.megalist;
+    kmem.megalist = kmem.megalist->next;
+    for(char *p = pa; p < pa + MEGAPGSIZE; p += PGSIZE){
+      r = (struct run*)p;
+      r->next = kmem.freelist;
+      kmem.freelist = r;
+    }
+  }
   r = kmem.freelist;
   if(r)
     kmem.freelist = r->next;
@@ -80,3 +116,62 @@ kalloc(void)
     memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
 }
+
+// Take another reference to the page at pa, so that it
+// survives until kfree() has been called once more.
+// Returns -1 if the page has too many references already.
+int
+kdup(void *pa)
+{
+  uint n;
+
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kdup");
+  do {
+    if((n = *PGREF(pa)) == ~0U)
+      return -1;
+  } while(!__sync_bool_compare_and_swap(PGREF(pa), n, n + 1));
+  return 0;
+}
+
+// Free the megapage of physical memory pointed at by pa,
+// which normally should have been returned by a call to
+// kalloc_mega().
+void
+kfree_mega(void *pa)
+{
+  struct run *r;
+
+  if(((uint64)pa % MEGAPGSIZE) != 0 || (char*)pa < end || (uint64)pa + MEGAPGSIZE > PHYSTOP)
+    panic("kfree_mega");
+
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, MEGAPGSIZE);
+
+  r = (struct run*)pa;
+
+  acquire(&kmem.lock);
+  r->next = kmem.megalist;
+  kmem.megalist = r;
+  release(&kmem.lock);
+}
+
+// Allocate one physically contiguous, aligned
+// 2-megabyte megapage.
+// Returns 0 if none is free; callers should fall
+// back to ordinary pages.
+void *
+kalloc_mega(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  r = kmem.megalist;
+  if(r)
+    kmem.megalist = r->next;
+  release(&kmem.lock);
+
+  if(r)
+    memset((char*)r, 5, MEGAPGSIZE); // fill with junk
+  return (void*)r;
+}
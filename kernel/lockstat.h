@@ -0,0 +1,9 @@
+// Lock statistics, as returned by the lockstat() system call.
+// The first NCPU records total each CPU's acquisitions and
+// spins over all locks; the rest are one per spinlock.
+struct lockstat {
+  char name[16];    // Name of lock, or "cpu0", "cpu1", ...
+  uint64 nacquire;  // Number of acquire()s
+  uint64 nspin;     // Failed test-and-sets while spinning
+  uint64 hold;      // Total time held, in time CSR units
+};
@@ -22,11 +22,11 @@ main()
     procinit();      // process table
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
+    timerqinit();    // timer queue and clock tick
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
     iinit();         // inode table
-    fileinit();      // file table
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -27,8 +27,10 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid))
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define MTIME_HZ 10000000L // CLINT_MTIME cycles per second, in qemu.
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -47,6 +49,11 @@
 #define KERNBASE 0x80000000L
 #define PHYSTOP (KERNBASE + 128*1024*1024)
 
+// with KVMUSER, each process's kernel page table also
+// maps its user memory, which must therefore stay below
+// the lowest device the kernel maps.
+#define MAXUVA PLIC
+
 // map the trampoline page to the highest address,
 // in both user and kernel space.
 #define TRAMPOLINE (MAXVA - PGSIZE)
@@ -62,6 +69,12 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   clone()d threads' trapframes
+//   UTIME (struct utime, shared by all processes)
+//   USYSCALL (p->usyscall, read-only to the process)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define USYSCALL (TRAPFRAME - PGSIZE)
+#define UTIME (USYSCALL - PGSIZE)
+#define THREADFRAME(i) (UTIME - (i)*PGSIZE)  // i from 1
@@ -3,10 +3,13 @@
 #include "defs.h"
 #include "param.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "fs.h"
-#include "sleeplock.h"
 #include "file.h"
+#include "waitq.h"
+#include "poll.h"
+#include "fcntl.h"
 
 #define PIPESIZE 512
 
@@ -17,6 +20,7 @@ struct pipe {
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  struct waitq wq; // poll()ers of either end
 };
 
 int
@@ -35,6 +39,7 @@ pipealloc(struct file **f0, struct file **f1)
   pi->nwrite = 0;
   pi->nread = 0;
   initlock(&pi->lock, "pipe");
+  initwaitq(&pi->wq, "pipewq");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
   (*f0)->writable = 0;
@@ -66,15 +71,33 @@ pipeclose(struct pipe *pi, int writable)
     pi->readopen = 0;
     wakeup(&pi->nwrite);
   }
+  wakeq(&pi->wq);
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
+    freelock(&pi->lock);
+    freelock(&pi->wq.lock);
     kfree((char*)pi);
   } else
     release(&pi->lock);
 }
 
+// The bytes a write to pi could add without waiting,
+// or -1 if there is no reader to take them.
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipespace(struct pipe *pi)
+{
+  int n;
+
+  acquire(&pi->lock);
+  n = pi->readopen ? PIPESIZE - (pi->nwrite - pi->nread) : -1;
+  release(&pi->lock);
+  return n;
+}
+
+// If nonblock, return what fits, or -EAGAIN if nothing does,
+// rather than waiting for a reader to make room.
+int
+pipewrite(struct pipe *pi, int user_src, uint64 addr, int n, int nonblock)
 {
   int i = 0;
   struct proc *pr = myproc();
@@ -86,24 +109,33 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       return -1;
     }
     if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
+      if(nonblock){
+        if(i == 0)
+          i = -EAGAIN;
+        break;
+      }
       wakeup(&pi->nread);
+      wakeq(&pi->wq);
       sleep(&pi->nwrite, &pi->lock);
     } else {
       char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+      if(either_copyin(&ch, user_src, addr + i, 1) == -1)
         break;
       pi->data[pi->nwrite++ % PIPESIZE] = ch;
       i++;
     }
   }
   wakeup(&pi->nread);
+  wakeq(&pi->wq);
   release(&pi->lock);
 
   return i;
 }
 
+// If nonblock, return -EAGAIN rather than waiting for a
+// writer when the pipe is empty.
 int
-piperead(struct pipe *pi, uint64 addr, int n)
+piperead(struct pipe *pi, int user_dst, uint64 addr, int n, int nonblock)
 {
   int i;
   struct proc *pr = myproc();
@@ -115,16 +147,46 @@ piperead(struct pipe *pi, uint64 addr, int n)
       release(&pi->lock);
       return -1;
     }
+    if(nonblock){
+      release(&pi->lock);
+      return -EAGAIN;
+    }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
   for(i = 0; i < n; i++){  //DOC: piperead-copy
     if(pi->nread == pi->nwrite)
       break;
     ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+    if(either_copyout(user_dst, addr + i, &ch, 1) == -1)
       break;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  wakeq(&pi->wq);
   release(&pi->lock);
   return i;
 }
+
+// Return the poll() events ready on the read end of pi, or the
+// write end if writable, putting the caller on pi's wait queue
+// with e (see pollwait()).
+int
+pipepoll(struct pipe *pi, int writable, struct pollent *e)
+{
+  int ev = 0;
+
+  acquire(&pi->lock);
+  pollwait(&pi->wq, e);
+  if(writable){
+    if(pi->readopen == 0)
+      ev |= POLLERR;
+    else if(pi->nwrite != pi->nread + PIPESIZE)
+      ev |= POLLOUT;
+  } else {
+    if(pi->nread != pi->nwrite)
+      ev |= POLLIN;
+    if(pi->writeopen == 0)
+      ev |= POLLHUP;
+  }
+  release(&pi->lock);
+  return ev;
+}
@@ -0,0 +1,113 @@
+// Wait queues for poll().
+//
+// poll() can't sleep() on one channel per descriptor, so each
+// pollable object keeps a waitq of the processes polling it.
+// A poller marks itself unwoken with pollarm(), registers on
+// every queue while checking readiness, and then sleeps in
+// pollsleep() until some wakeq() marks it woken. Because
+// pollarm() comes before the checks, a change after a check
+// can't be missed.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "waitq.h"
+
+// protects p->pollev.
+struct spinlock polllock = { .name = "poll" };
+
+void
+initwaitq(struct waitq *q, char *name)
+{
+  initlock(&q->lock, name);
+  q->head = 0;
+}
+
+// Put the current process on q, using e.
+// A null e means the caller isn't registering.
+void
+pollwait(struct waitq *q, struct pollent *e)
+{
+  if(e == 0 || e->q != 0)
+    return;
+  e->p = myproc();
+  e->q = q;
+  acquire(&q->lock);
+  e->next = q->head;
+  q->head = e;
+  release(&q->lock);
+}
+
+// Take e off the queue pollwait() put it on.
+void
+pollunwait(struct pollent *e)
+{
+  struct pollent **pp;
+  struct waitq *q = e->q;
+
+  if(q == 0)
+    return;
+  acquire(&q->lock);
+  for(pp = &q->head; *pp; pp = &(*pp)->next){
+    if(*pp == e){
+      *pp = e->next;
+      break;
+    }
+  }
+  release(&q->lock);
+  e->q = 0;
+}
+
+// Wake every process polling q.
+void
+wakeq(struct waitq *q)
+{
+  struct pollent *e;
+
+  // an unlocked look is enough: a poller registers before
+  // checking the object, under the lock the caller holds
+  // while changing it.
+  if(q->head == 0)
+    return;
+
+  acquire(&q->lock);
+  for(e = q->head; e; e = e->next){
+    acquire(&polllock);
+    e->p->pollev = 1;
+    release(&polllock);
+    wakeup(&e->p->pollev);
+  }
+  release(&q->lock);
+}
+
+// Start a round of readiness checks.
+void
+pollarm(void)
+{
+  acquire(&polllock);
+  myproc()->pollev = 0;
+  release(&polllock);
+}
+
+// Sleep until a wakeq() since the last pollarm().
+// Returns -1 if the process was killed.
+int
+pollsleep(void)
+{
+  struct proc *p = myproc();
+
+  acquire(&polllock);
+  while(p->pollev == 0){
+    if(killed(p)){
+      release(&polllock);
+      return -1;
+    }
+    sleep(&p->pollev, &polllock);
+  }
+  release(&polllock);
+  return 0;
+}
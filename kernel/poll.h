@@ -0,0 +1,14 @@
+// poll() descriptor and events.
+struct pollfd {
+  int fd;         // descriptor to watch, or negative to skip
+  short events;   // events the caller is interested in
+  short revents;  // events that occurred, set by poll()
+};
+
+#define POLLIN    0x001  // there is data to read
+#define POLLOUT   0x004  // writing won't block
+#define POLLERR   0x008  // error, e.g. pipe with no reader
+#define POLLHUP   0x010  // hung up, e.g. pipe with no writer
+#define POLLNVAL  0x020  // fd isn't open
+
+#define POLLMAX   64     // most descriptors per poll()
@@ -17,16 +17,62 @@
 
 volatile int panicked = 0;
 
-// lock to avoid interleaving concurrent printf's.
+// lock to avoid interleaving concurrent printf's
+// while printing straight to the console.
 static struct {
   struct spinlock lock;
   int locking;
+  int async;      // printf() appends to the calling CPU's log
 } pr;
 
+// The kernel log. Once printfinit() has run, printf() appends
+// to a ring that belongs to the calling CPU, with interrupts
+// off and without locks, since no other CPU writes it.
+// logdrain(), called from the timer interrupt, moves what has
+// been published from every CPU's ring into klog, which
+// dmesg() reads, and from there to the console by way of the
+// uart's transmit buffer.
+#define CPULOGSZ 1024
+#define KLOGSZ   4096
+
+struct cpulog {
+  char buf[CPULOGSZ];
+  uint64 w;     // bytes published; logdrain() may read below w
+  uint64 wnext; // bytes written, including a message in progress
+  uint64 resv;  // wnext won't pass resv without a fence first
+  uint64 r;     // bytes moved to klog, by logdrain()
+};
+
+static struct cpulog cpulogs[NCPU];
+
+static struct {
+  struct spinlock lock;
+  char buf[KLOGSZ];
+  uint64 w;     // bytes ever logged
+  uint64 c;     // bytes handed to the uart
+} klog;
+
 static char digits[] = "0123456789abcdef";
 
+// append c to log l, or send it to the console if l is 0.
+static void
+putch(struct cpulog *l, int c)
+{
+  if(l == 0){
+    consputc(c);
+    return;
+  }
+  if(l->wnext == l->resv){
+    // tell logdrain() which old bytes are about to be
+    // overwritten before overwriting them.
+    l->resv += 64;
+    __sync_synchronize();
+  }
+  l->buf[l->wnext++ % CPULOGSZ] = c;
+}
+
 static void
-printint(int xx, int base, int sign)
+printint(struct cpulog *l, int xx, int base, int sign)
 {
   char buf[16];
   int i;
@@ -46,30 +92,39 @@ printint(int xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    putch(l, buf[i]);
 }
 
 static void
-printptr(uint64 x)
+printptr(struct cpulog *l, uint64 x)
 {
   int i;
-  consputc('0');
-  consputc('x');
+  putch(l, '0');
+  putch(l, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putch(l, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
-// Print to the console. only understands %d, %x, %p, %s.
+// Print to the kernel log, or to the console before
+// printfinit() and after a panic. only understands %d, %x, %p, %s.
 void
 printf(char *fmt, ...)
 {
   va_list ap;
   int i, c, locking;
   char *s;
+  struct cpulog *l;
 
-  locking = pr.locking;
-  if(locking)
-    acquire(&pr.lock);
+  l = 0;
+  locking = 0;
+  if(pr.async){
+    push_off();
+    l = &cpulogs[cpuid()];
+  } else {
+    locking = pr.locking;
+    if(locking)
+      acquire(&pr.lock);
+  }
 
   if (fmt == 0)
     panic("null fmt");
@@ -77,7 +132,7 @@ printf(char *fmt, ...)
   va_start(ap, fmt);
   for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
     if(c != '%'){
-      consputc(c);
+      putch(l, c);
       continue;
     }
     c = fmt[++i] & 0xff;
@@ -85,40 +140,141 @@ printf(char *fmt, ...)
       break;
     switch(c){
     case 'd':
-      printint(va_arg(ap, int), 10, 1);
+      printint(l, va_arg(ap, int), 10, 1);
       break;
     case 'x':
-      printint(va_arg(ap, int), 16, 1);
+      printint(l, va_arg(ap, int), 16, 1);
       break;
     case 'p':
-      printptr(va_arg(ap, uint64));
+      printptr(l, va_arg(ap, uint64));
       break;
     case 's':
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        putch(l, *s);
       break;
     case '%':
-      consputc('%');
+      putch(l, '%');
       break;
     default:
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c);
+      putch(l, '%');
+      putch(l, c);
       break;
     }
   }
   va_end(ap);
 
+  if(l){
+    // publish the whole message at once.
+    __sync_synchronize();
+    l->w = l->wnext;
+    pop_off();
+  }
   if(locking)
     release(&pr.lock);
 }
 
+// move newly published messages from each CPU's log to klog,
+// and as much of klog as fits to the uart. called on CPU 0
+// from clockintr(), and by dmesg().
+void
+logdrain(void)
+{
+  struct cpulog *l;
+  uint64 r, w, i, n;
+
+  acquire(&klog.lock);
+  for(l = cpulogs; l < &cpulogs[NCPU]; l++){
+    for(;;){
+      w = l->w;
+      __sync_synchronize();
+      r = l->r;
+      if(w - r > CPULOGSZ)
+        r = w - CPULOGSZ;  // fell behind; messages lost
+      n = 0;
+      for(i = r; i < w; i++)
+        klog.buf[(klog.w + n++) % KLOGSZ] = l->buf[i % CPULOGSZ];
+      __sync_synchronize();
+      if(r + CPULOGSZ >= l->resv)
+        break;
+      // the CPU overwrote some of what we copied; skip it.
+      l->r = l->resv - CPULOGSZ;
+    }
+    klog.w += n;
+    l->r = w;
+  }
+
+  if(klog.w - klog.c > KLOGSZ)
+    klog.c = klog.w - KLOGSZ;
+  while(klog.c < klog.w){
+    n = klog.w - klog.c;
+    if(n > KLOGSZ - klog.c % KLOGSZ)
+      n = KLOGSZ - klog.c % KLOGSZ;
+    i = uarttrywrite(&klog.buf[klog.c % KLOGSZ], n);
+    klog.c += i;
+    if(i < n)
+      break;  // uart buffer is full; try again next tick.
+  }
+  release(&klog.lock);
+}
+
+// copy the last (up to) n bytes of the kernel log to user
+// address dst. returns the number of bytes copied, or -1.
+int
+logread(uint64 dst, int n)
+{
+  uint64 r, m;
+  int tot;
+
+  if(n < 0)
+    return -1;
+  logdrain();
+
+  acquire(&klog.lock);
+  if(n > KLOGSZ)
+    n = KLOGSZ;
+  if(n > klog.w)
+    n = klog.w;
+  r = klog.w - n;
+  for(tot = 0; tot < n; tot += m){
+    m = n - tot;
+    if(m > KLOGSZ - r % KLOGSZ)
+      m = KLOGSZ - r % KLOGSZ;
+    if(copyout(myproc()->pagetable, dst + tot, &klog.buf[r % KLOGSZ], m) < 0){
+      release(&klog.lock);
+      return -1;
+    }
+    r += m;
+  }
+  release(&klog.lock);
+  return n;
+}
+
 void
 panic(char *s)
 {
+  struct cpulog *l;
+  uint64 i;
+
   pr.locking = 0;
+  pr.async = 0;
+
+  // get out whatever is still in the log, without locks.
+  i = klog.c;
+  if(klog.w - i > KLOGSZ)
+    i = klog.w - KLOGSZ;
+  for(; i < klog.w; i++)
+    consputc(klog.buf[i % KLOGSZ]);
+  for(l = cpulogs; l < &cpulogs[NCPU]; l++){
+    i = l->r;
+    if(l->w - i > CPULOGSZ)
+      i = l->w - CPULOGSZ;
+    for(; i < l->w; i++)
+      consputc(l->buf[i % CPULOGSZ]);
+  }
+
   printf("panic: ");
   printf(s);
   printf("\n");
@@ -131,5 +287,7 @@ void
 printfinit(void)
 {
   initlock(&pr.lock, "pr");
+  initlock(&klog.lock, "klog");
   pr.locking = 1;
+  pr.async = 1;
 }
@@ -3,7 +3,9 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
+#include "usyscall.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
@@ -15,11 +17,40 @@ struct proc *initproc;
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// makes futexwait()'s check of the user's word and
+// its sleep atomic with respect to futexwake().
+struct spinlock futex_lock;
+
 extern void forkret(void);
 static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
+extern pagetable_t kernel_pagetable; // vm.c
+
+// RISC-V address-space identifiers. each process gets an ASID
+// for its page table, so that returning to user space needn't
+// flush the TLB. when they run out, a new generation starts:
+// every process gets a fresh ASID, and each CPU flushes its
+// TLB before using any ASID of the new generation.
+// ASID 0 belongs to the kernel page table. with KVMUSER, a
+// process's own kernel page table maps the top of the address
+// space differently from its user page table (kernel stacks
+// where the user has trapframes), so it gets the next ASID,
+// p->asid+1, and ASIDs are handed out in pairs.
+#ifdef KVMUSER
+#define NASID 2
+#else
+#define NASID 1
+#endif
+
+struct {
+  struct spinlock lock;
+  uint64 max;         // largest ASID the hardware supports; 0 if none
+  uint64 next;        // next ASID to hand out
+  uint64 generation;  // incremented when ASIDs are recycled
+} asids;
+
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
 // memory model when using p->parent.
@@ -51,13 +82,138 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  initlock(&futex_lock, "futex");
+  asidinit();
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
+      initsleeplock(&p->memlock, "memlock");
+      initlock(&p->threadlock, "threadlock");
       p->state = UNUSED;
       p->kstack = KSTACK((int) (p - proc));
   }
 }
 
+// Find out how many ASID bits the hardware implements,
+// by writing all ones to the ASID field of satp and
+// reading back what sticks.
+void
+asidinit(void)
+{
+  uint64 satp = r_satp();
+
+  initlock(&asids.lock, "asids");
+  w_satp(satp | SATP_ASID_MASK);
+  asids.max = (r_satp() & SATP_ASID_MASK) >> SATP_ASID_SHIFT;
+  if(asids.max < NASID)
+    asids.max = 0;
+  w_satp(satp);
+  sfence_vma();
+  asids.next = 1;
+  asids.generation = 1;
+}
+
+// Return the ASID that tags p's page tables in satp. Hands p
+// a fresh ASID if it has none from the current generation,
+// and flushes this CPU's TLB if ASIDs have been recycled
+// since it last did; only then is asids.lock taken.
+// Returns 0 if the hardware has no ASIDs.
+// Interrupts must be disabled.
+uint64
+proc_asid(struct proc *p)
+{
+  struct cpu *c = mycpu();
+  uint64 gen;
+  int fresh = 0;
+
+  if(asids.max == 0){
+    // no ASIDs; flush on every switch.
+    return 0;
+  }
+
+  // the common case needs no lock: p's ASID and this CPU's
+  // TLB are both of the current generation. a generation
+  // that moves on just after the read is no different from
+  // one that moves on just after the lock is released.
+  gen = *(volatile uint64*)&asids.generation;
+  __sync_synchronize();
+  if(p->asidgen == gen && c->asidgen == gen)
+    return p->asid;
+
+  acquire(&asids.lock);
+  if(p->asidgen != asids.generation){
+    if(asids.next + NASID - 1 > asids.max){
+      asids.generation++;
+      asids.next = 1;
+    }
+    p->asid = asids.next;
+    asids.next += NASID;
+    p->asidgen = asids.generation;
+    fresh = 1;
+  }
+  gen = asids.generation;
+  release(&asids.lock);
+
+  if(c->asidgen != gen){
+    sfence_vma();
+    c->asidgen = gen;
+  } else if(fresh){
+    // make this CPU's page-table writes visible to the
+    // page-table walker under the new ASIDs.
+    for(int i = 0; i < NASID; i++)
+      sfence_vma_asid(p->asid + i);
+  }
+
+  return p->asid;
+}
+
+// Give up p's ASID after its page table has been changed
+// or replaced, so that stale TLB entries tagged with it
+// can't be used; p gets a fresh one on its next return
+// to user space.
+void
+proc_flushasid(struct proc *p)
+{
+#ifdef KVMUSER
+  // this CPU is running on p's kernel page table, under
+  // the old ASID, and must not see the old user mappings.
+  if(asids.max == 0)
+    sfence_vma();
+  else
+    for(int i = 0; i < NASID; i++)
+      sfence_vma_asid(p->asid + i);
+#endif
+  p->asidgen = 0;
+}
+
+// Return the satp value for p's kernel code, given p's ASID:
+// with KVMUSER, p's own kernel page table, which also maps its
+// user memory, tagged with the ASID after asid; otherwise the
+// shared kernel page table, which is ASID 0.
+uint64
+proc_ksatp(struct proc *p, uint64 asid)
+{
+#ifdef KVMUSER
+  return MAKE_SATP_ASID(p->kpagetable, asid ? asid + 1 : 0);
+#else
+  return MAKE_SATP(kernel_pagetable);
+#endif
+}
+
+#ifdef KVMUSER
+// Install a kernel page table on this CPU. Different kernel
+// page tables map user addresses differently, so without
+// ASIDs to tell their TLB entries apart, flush.
+static void
+kvmswitch(uint64 satp)
+{
+  if(asids.max == 0)
+    sfence_vma();
+  w_satp(satp);
+  if(asids.max == 0)
+    sfence_vma();
+}
+#endif
+
 // Must be called with interrupts disabled,
 // to prevent race with process being moved
 // to a different CPU.
@@ -124,6 +280,11 @@ allocproc(void)
 found:
   p->pid = allocpid();
   p->state = USED;
+  p->ofile = p->ofile0;
+  p->nofile = NOFILE;
+  p->leader = p;
+  p->nthread = 1;
+  p->tfva = TRAPFRAME;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -132,6 +293,15 @@ found:
     return 0;
   }
 
+  // Allocate the page user code reads getpid() from.
+  if((p->usyscall = (struct usyscall *)kalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  memset(p->usyscall, 0, PGSIZE);
+  p->usyscall->pid = p->pid;
+
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
@@ -140,6 +310,16 @@ found:
     return 0;
   }
 
+#ifdef KVMUSER
+  // A kernel page table that will mirror the user page table.
+  p->kpagetable = kvmcreate();
+  if(p->kpagetable == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+#endif
+
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
@@ -158,9 +338,26 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
+  // a thread's exit() has already let go of the
+  // page table it shared.
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
+  p->leader = 0;
+  p->nthread = 0;
+  p->tfva = 0;
+  if(p->kpagetable)
+    kvmfree(p->kpagetable);
+  p->kpagetable = 0;
+  p->asid = 0;
+  p->asidgen = 0;
+  if(p->ofile && p->ofile != p->ofile0)
+    kfree((void*)p->ofile);
+  p->ofile = p->ofile0;
+  p->nofile = NOFILE;
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
@@ -202,6 +399,24 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the pages that let getpid() and uptime() run
+  // without a trap, read-only, below the trapframe.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+  if(mappages(pagetable, UTIME, PGSIZE,
+              (uint64)utime, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, USYSCALL, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -212,6 +427,8 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 0);
+  uvmunmap(pagetable, UTIME, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -241,6 +458,9 @@ userinit(void)
   // and data into it.
   uvmfirst(p->pagetable, initcode, sizeof(initcode));
   p->sz = PGSIZE;
+#ifdef KVMUSER
+  kvmmapuser(p->kpagetable, p->pagetable);
+#endif
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
@@ -254,24 +474,105 @@ userinit(void)
   release(&p->lock);
 }
 
-// Grow or shrink user memory by n bytes.
+// Every thread sharing leader l's page table sees
+// the new size sz. Caller holds l->memlock.
+static void
+setsz(struct proc *l, uint64 sz)
+{
+  struct proc *pp;
+
+  for(pp = proc; pp < &proc[NPROC]; pp++){
+    if(pp->leader == l){
+      pp->sz = sz;
+#ifdef KVMUSER
+      kvmmapuser(pp->kpagetable, pp->pagetable);
+#endif
+    }
+  }
+}
+
+// Grow or shrink user memory by n bytes,
+// setting *oldsz to the size before.
 // Return 0 on success, -1 on failure.
 int
-growproc(int n)
+growproc(int n, uint64 *oldsz)
 {
   uint64 sz;
   struct proc *p = myproc();
+  struct proc *l = p->leader;
 
-  sz = p->sz;
+  acquiresleep(&l->memlock);
+  sz = *oldsz = p->sz;
   if(n > 0){
+#ifdef KVMUSER
+    // user memory must stay below the devices that
+    // kernel page tables map at the bottom of memory.
+    if(sz + n > MAXUVA)
+      goto bad;
+#endif
     if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
-      return -1;
+      goto bad;
     }
   } else if(n < 0){
+    // other threads may be running on other CPUs, whose
+    // TLBs this CPU can't flush.
+    if(l->nthread > 1)
+      goto bad;
+    // a megapage that straddles the new end must be
+    // split before its tail can be freed.
+    if(uvmsplit(p->pagetable, PGROUNDUP(sz + n)) < 0)
+      goto bad;
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+
+  setsz(l, sz);
+  proc_flushasid(p);
+  releasesleep(&l->memlock);
   return 0;
+
+bad:
+  releasesleep(&l->memlock);
+  return -1;
+}
+
+// Map the n physical pages in pa[] just above the current
+// process's memory, sharing them with whoever else maps
+// them, and grow the process to cover them.
+// Return their user address, or -1.
+uint64
+growshared(uint64 *pa, int n)
+{
+  uint64 va;
+  int i;
+  struct proc *p = myproc();
+  struct proc *l = p->leader;
+
+  acquiresleep(&l->memlock);
+  va = PGROUNDUP(p->sz);
+#ifdef KVMUSER
+  if(va + (uint64)n*PGSIZE > MAXUVA){
+    releasesleep(&l->memlock);
+    return -1;
+  }
+#endif
+  for(i = 0; i < n; i++){
+    if(kdup((void*)pa[i]) < 0)
+      goto bad;
+    if(mappages(p->pagetable, va + i*PGSIZE, PGSIZE, pa[i], PTE_R|PTE_W|PTE_U|PTE_S) != 0){
+      kfree((void*)pa[i]);
+      goto bad;
+    }
+  }
+  setsz(l, va + n*PGSIZE);
+  proc_flushasid(p);
+  releasesleep(&l->memlock);
+  return va;
+
+bad:
+  // unmap the pages mapped so far, dropping their references.
+  uvmunmap(p->pagetable, va, i, 1);
+  releasesleep(&l->memlock);
+  return -1;
 }
 
 // Create a new process, copying the parent.
@@ -287,14 +588,21 @@ fork(void)
   if((np = allocproc()) == 0){
     return -1;
   }
+  // nothing else can find np yet, and memlock sleeps.
+  release(&np->lock);
 
-  // Copy user memory from parent to child.
+  // Copy user memory from parent to child, which
+  // other threads mustn't change meanwhile.
+  acquiresleep(&p->leader->memlock);
   if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
-    freeproc(np);
-    release(&np->lock);
-    return -1;
+    releasesleep(&p->leader->memlock);
+    goto bad;
   }
   np->sz = p->sz;
+  releasesleep(&p->leader->memlock);
+#ifdef KVMUSER
+  kvmmapuser(np->kpagetable, np->pagetable);
+#endif
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -303,17 +611,100 @@ fork(void)
   np->trapframe->a0 = 0;
 
   // increment reference counts on open file descriptors.
-  for(i = 0; i < NOFILE; i++)
+  if(p->nofile > np->nofile && growfds(np) < 0)
+    goto bad;
+  // another thread's close() mustn't free a file between
+  // the look and the filedup(); see fdget() in sysfile.c.
+  acquiresleep(&p->leader->memlock);
+  for(i = 0; i < p->nofile; i++)
     if(p->ofile[i])
       np->ofile[i] = filedup(p->ofile[i]);
+  releasesleep(&p->leader->memlock);
   np->cwd = idup(p->cwd);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
   pid = np->pid;
 
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  release(&np->lock);
+  kickidle();
+
+  return pid;
+
+bad:
+  acquire(&np->lock);
+  freeproc(np);
+  release(&np->lock);
+  return -1;
+}
+
+// Create a thread that shares the caller's page table and
+// open files, and starts at fn(arg) on the given user stack.
+// Its parent, which can wait() for it, is the caller.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int i, tid;
+  uint64 va;
+  pte_t *pte;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *l = p->leader;
+
+  if((np = allocproc()) == 0)
+    return -1;
+  // nothing else can find np yet, and memlock comes first.
   release(&np->lock);
 
+  // np runs on l's page table, not the one allocproc() made.
+  proc_freepagetable(np->pagetable, 0);
+  np->pagetable = 0;
+
+  acquiresleep(&l->memlock);
+
+  // give the threads a file table that needn't move, since
+  // they use it without locks.
+  if(l->nofile < NOFILEMAX && growfds(l) < 0)
+    goto bad;
+
+  // find a free slot for np's trapframe below l's.
+  for(i = 1; i < NPROC; i++){
+    va = THREADFRAME(i);
+    pte = walk(l->pagetable, va, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0)
+      break;
+  }
+  if(i == NPROC || mappages(l->pagetable, va, PGSIZE,
+                            (uint64)np->trapframe, PTE_R | PTE_W) < 0)
+    goto bad;
+  np->tfva = va;
+  np->pagetable = l->pagetable;
+  np->sz = l->sz;
+  np->ofile = l->ofile;
+  np->nofile = l->nofile;
+  acquire(&l->threadlock);
+  np->leader = l;
+  l->nthread++;
+  release(&l->threadlock);
+#ifdef KVMUSER
+  kvmmapuser(np->kpagetable, np->pagetable);
+#endif
+  releasesleep(&l->memlock);
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->cwd = idup(p->cwd);
+  safestrcpy(np->name, p->name, sizeof(p->name));
+  tid = np->pid;
+
   acquire(&wait_lock);
   np->parent = p;
   release(&wait_lock);
@@ -321,8 +712,34 @@ fork(void)
   acquire(&np->lock);
   np->state = RUNNABLE;
   release(&np->lock);
+  kickidle();
 
-  return pid;
+  return tid;
+
+bad:
+  releasesleep(&l->memlock);
+  acquire(&np->lock);
+  freeproc(np);
+  release(&np->lock);
+  return -1;
+}
+
+// Make room in p's file descriptor table for NOFILEMAX
+// open files. Return 0 on success, -1 on failure.
+int
+growfds(struct proc *p)
+{
+  struct file **ofile;
+
+  if(p->nofile >= NOFILEMAX)
+    return -1;
+  if((ofile = (struct file **)kalloc()) == 0)
+    return -1;
+  memset(ofile, 0, PGSIZE);
+  memmove(ofile, p->ofile, p->nofile * sizeof(struct file *));
+  p->ofile = ofile;
+  p->nofile = NOFILEMAX;
+  return 0;
 }
 
 // Pass p's abandoned children to init.
@@ -340,6 +757,55 @@ reparent(struct proc *p)
   }
 }
 
+// Detach exiting thread p from the memory and files it
+// shares with its leader, leaving it nothing for freeproc()
+// to free but its own trapframe.
+static void
+threadexit(struct proc *p)
+{
+  struct proc *l = p->leader;
+
+  acquiresleep(&l->memlock);
+  uvmunmap(p->pagetable, p->tfva, 1, 0);
+  p->pagetable = 0;
+  p->ofile = p->ofile0;
+  p->nofile = NOFILE;
+  acquire(&l->threadlock);
+  p->leader = 0;
+  l->nthread--;
+  wakeup(&l->nthread);
+  release(&l->threadlock);
+  releasesleep(&l->memlock);
+}
+
+// Kill leader l's threads and wait for them to threadexit().
+static void
+killthreads(struct proc *l)
+{
+  struct proc *pp;
+
+  acquire(&l->threadlock);
+  for(;;){
+    // again each time round, in case a thread clone()d
+    // another before it died.
+    for(pp = proc; pp < &proc[NPROC]; pp++){
+      if(pp != l && pp->leader == l){
+        acquire(&pp->lock);
+        pp->killed = 1;
+        if(pp->state == SLEEPING){
+          pp->state = RUNNABLE;
+          kickidle();
+        }
+        release(&pp->lock);
+      }
+    }
+    if(l->nthread == 1)
+      break;
+    sleep(&l->nthread, &l->threadlock);
+  }
+  release(&l->threadlock);
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait().
@@ -351,12 +817,21 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
+  if(p->leader != p){
+    threadexit(p);
+  } else {
+    // the threads use this process's memory and files, so
+    // they must go first.
+    if(p->nthread > 1)
+      killthreads(p);
+
+    // Close all open files.
+    for(int fd = 0; fd < p->nofile; fd++){
+      if(p->ofile[fd]){
+        struct file *f = p->ofile[fd];
+        fileclose(f);
+        p->ofile[fd] = 0;
+      }
     }
   }
 
@@ -434,6 +909,32 @@ wait(uint64 addr)
   }
 }
 
+// Nothing was RUNNABLE: wait for an interrupt without a time
+// slice, and so, on CPUs other than 0, without timer interrupts.
+// idle is set before looking once more, with interrupts off, so
+// a process made RUNNABLE after the look gets a kickidle(),
+// whose interrupt ends the wfi.
+static void
+idle(struct cpu *c)
+{
+  struct proc *p;
+  int found = 0;
+
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  for(p = proc; p < &proc[NPROC] && !found; p++){
+    acquire(&p->lock);
+    found = p->state == RUNNABLE;
+    release(&p->lock);
+  }
+  if(!found){
+    timerarm();
+    asm volatile("wfi");
+  }
+  c->idle = 0;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -446,12 +947,17 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int found;
   
   c->proc = 0;
   for(;;){
+    // no process runs here, so no RCU readers either.
+    rcuquiescent();
+
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
+    found = 0;
     for(p = proc; p < &proc[NPROC]; p++) {
       acquire(&p->lock);
       if(p->state == RUNNABLE) {
@@ -460,14 +966,28 @@ scheduler(void)
         // before jumping back to us.
         p->state = RUNNING;
         c->proc = p;
+        found = 1;
+        timerslice();
+#ifdef KVMUSER
+        // run p's kernel code on its own kernel page table,
+        // so that copyin() and copyout() can reach its user
+        // memory directly.
+        kvmswitch(proc_ksatp(p, proc_asid(p)));
+#endif
         swtch(&c->context, &p->context);
+#ifdef KVMUSER
+        kvmswitch(MAKE_SATP(kernel_pagetable));
+#endif
 
         // Process is done running for now.
         // It should have changed its p->state before coming back.
         c->proc = 0;
+        c->slice = 0;
       }
       release(&p->lock);
     }
+    if(!found)
+      idle(c);
   }
 }
 
@@ -573,10 +1093,73 @@ wakeup(void *chan)
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
         p->state = RUNNABLE;
+        kickidle();
+      }
+      release(&p->lock);
+    }
+  }
+}
+
+// The sleep channel for the user word at addr: its physical
+// address, so that processes sharing the page by any means
+// find the same one. 0 if addr isn't a mapped, aligned word.
+static void*
+futexchan(uint64 addr)
+{
+  uint64 pa;
+
+  if(addr % sizeof(int) != 0)
+    return 0;
+  if((pa = walkaddr(myproc()->pagetable, addr)) == 0)
+    return 0;
+  return (void*)(pa + (addr & (PGSIZE-1)));
+}
+
+// Sleep until a futexwake() on addr, if the int there is
+// still val. Returns 0 after sleeping, -1 if it wasn't val
+// or on error.
+int
+futexwait(uint64 addr, int val)
+{
+  struct proc *p = myproc();
+  void *chan;
+  int v;
+
+  acquire(&futex_lock);
+  if((chan = futexchan(addr)) == 0 ||
+     copyin(p->pagetable, (char*)&v, addr, sizeof(v)) < 0 ||
+     v != val || killed(p)){
+    release(&futex_lock);
+    return -1;
+  }
+  sleep(chan, &futex_lock);
+  release(&futex_lock);
+  return 0;
+}
+
+// Wake at most n processes in futexwait() on addr.
+// Returns the number woken.
+int
+futexwake(uint64 addr, int n)
+{
+  struct proc *p;
+  void *chan;
+  int woken = 0;
+
+  acquire(&futex_lock);
+  if((chan = futexchan(addr)) != 0){
+    for(p = proc; p < &proc[NPROC] && woken < n; p++){
+      acquire(&p->lock);
+      if(p->state == SLEEPING && p->chan == chan){
+        p->state = RUNNABLE;
+        kickidle();
+        woken++;
       }
       release(&p->lock);
     }
   }
+  release(&futex_lock);
+  return woken;
 }
 
 // Kill the process with the given pid.
@@ -594,6 +1177,7 @@ kill(int pid)
       if(p->state == SLEEPING){
         // Wake process from sleep().
         p->state = RUNNABLE;
+        kickidle();
       }
       release(&p->lock);
       return 0;
@@ -24,6 +24,13 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 asidgen;             // ASID generation this CPU's TLB was last flushed for
+  uint64 nacquire;            // acquire()s on this CPU, of any lock
+  uint64 nspin;               // Failed test-and-sets in those acquire()s
+  uint64 rcuqs;               // RCU quiescent states passed, see rcu.c
+  uint64 slice;               // CLINT_MTIME at which proc's time slice ends, or 0
+  uint64 armed;               // CLINT_MTIME this hart's timer is set for, see timer.c
+  int idle;                   // In scheduler() with nothing to run, waiting for kickidle()
 };
 
 extern struct cpu cpus[NCPU];
@@ -95,13 +102,32 @@ struct proc {
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
 
+  // polllock must be held when using this:
+  int pollev;                  // wakeq() since poll()'s last pollarm()?
+
+  // leader->memlock must be held to change the leader's page
+  // table, size, or file table. it is a sleeplock, since growing
+  // memory zeroes pages. changing leader or nthread takes both
+  // it and leader->threadlock; reading them takes either.
+  struct proc *leader;         // Process whose memory this thread shares; 0 once exited
+  int nthread;                 // In a leader, threads sharing its memory, itself included
+  struct sleeplock memlock;
+  struct spinlock threadlock;  // killthreads() sleeps on nthread with this
+
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
+  pagetable_t kpagetable;      // Kernel page table mirroring pagetable (KVMUSER)
+  uint64 asid;                 // Address-space ID tagging pagetable's TLB entries
+  uint64 asidgen;              // ASID generation asid belongs to; stale means none
   struct trapframe *trapframe; // data page for trampoline.S
+  uint64 tfva;                 // User virtual address of trapframe
+  struct usyscall *usyscall;   // page mapped read-only at USYSCALL
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files
+  struct file **ofile;         // Open files, ofile[0..nofile-1]
+  int nofile;                  // NOFILE, or NOFILEMAX after growfds()
+  struct file *ofile0[NOFILE]; // ofile until growfds()
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
 };
@@ -0,0 +1,75 @@
+// Read-copy-update, for data that readers look at without locks.
+//
+// A reader brackets its use of the data with rcureadlock() and
+// rcureadunlock(), which just turn interrupts off, so a reader
+// can't sleep or be switched away from. A CPU is therefore
+// outside any read-side section whenever it is in scheduler()
+// or comes into the kernel from user space; each CPU counts
+// these quiescent states in c->rcuqs.
+//
+// A writer unlinks an object so that new readers can't find it,
+// then calls rcusnap(). Once rcupassed() says that every CPU has
+// had a quiescent state since, no reader can still be looking at
+// the object, and it can be reused.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "defs.h"
+
+void
+rcureadlock(void)
+{
+  push_off();
+}
+
+void
+rcureadunlock(void)
+{
+  pop_off();
+}
+
+// note that this CPU isn't in a read-side section.
+// interrupts must be off.
+void
+rcuquiescent(void)
+{
+  mycpu()->rcuqs++;
+}
+
+// record each CPU's quiescent state count in snap[NCPU].
+void
+rcusnap(uint64 *snap)
+{
+  int i, me;
+
+  __sync_synchronize();
+  push_off();
+  me = cpuid();
+  for(i = 0; i < NCPU; i++)
+    snap[i] = cpus[i].rcuqs;
+  // the caller isn't a reader, so this CPU is quiescent now.
+  snap[me] -= 1;
+  pop_off();
+}
+
+// has every CPU had a quiescent state since rcusnap(snap)?
+// CPUs that hadn't started yet at the snapshot count as having
+// had one, as do idle ones, which may wait in scheduler() for
+// a long time without counting.
+int
+rcupassed(uint64 *snap)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    if(snap[i] != 0 && *(volatile uint64*)&cpus[i].rcuqs == snap[i] &&
+       !*(volatile int*)&cpus[i].idle)
+      return 0;
+  __sync_synchronize();
+  return 1;
+}
@@ -0,0 +1,72 @@
+// Reader-writer spin locks, for data that is read much more
+// often than it is written. Readers share the lock; a writer
+// waits for readers to leave, and keeps new ones out while it
+// waits, so a stream of readers can't starve it.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "rwlock.h"
+#include "riscv.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "defs.h"
+
+void
+initrwlock(struct rwlock *lk, char *name)
+{
+  lk->name = name;
+  lk->state = 0;
+}
+
+void
+acquireread(struct rwlock *lk)
+{
+  uint s;
+
+  push_off(); // disable interrupts to avoid deadlock.
+  for(;;){
+    s = *(volatile uint*)&lk->state;
+    if((s & RW_WRITER) == 0 && __sync_bool_compare_and_swap(&lk->state, s, s+1))
+      break;
+  }
+  __sync_synchronize();
+}
+
+void
+releaseread(struct rwlock *lk)
+{
+  __sync_synchronize();
+  if((lk->state & ~RW_WRITER) == 0)
+    panic("releaseread");
+  __sync_fetch_and_sub(&lk->state, 1);
+  pop_off();
+}
+
+void
+acquirewrite(struct rwlock *lk)
+{
+  uint s;
+
+  push_off(); // disable interrupts to avoid deadlock.
+  // claim the writer bit, then wait for the readers to drain.
+  for(;;){
+    s = *(volatile uint*)&lk->state;
+    if((s & RW_WRITER) == 0 && __sync_bool_compare_and_swap(&lk->state, s, s|RW_WRITER))
+      break;
+  }
+  while(*(volatile uint*)&lk->state != RW_WRITER)
+    ;
+  __sync_synchronize();
+}
+
+void
+releasewrite(struct rwlock *lk)
+{
+  if(lk->state != RW_WRITER)
+    panic("releasewrite");
+  __sync_synchronize();
+  __sync_lock_release(&lk->state);
+  pop_off();
+}
@@ -0,0 +1,9 @@
+// Reader-writer spin lock: any number of readers, or one writer.
+struct rwlock {
+  uint state;        // RW_WRITER bit, plus number of readers
+
+  // For debugging:
+  char *name;        // Name of lock.
+};
+
+#define RW_WRITER (1U<<31)
@@ -0,0 +1,62 @@
+// Sequence locks, for small data that is read often and written
+// rarely. Readers take no lock and never make writers wait;
+// they copy the data and check that no write overlapped the
+// copy, and if one did, try again. Writers must exclude each
+// other by other means, usually a spinlock.
+//
+// A reader looks like:
+//   do {
+//     seq = seqbegin(&s);
+//     ... copy the data ...
+//   } while(seqretry(&s, seq));
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "seqlock.h"
+#include "riscv.h"
+#include "defs.h"
+
+void
+initseqlock(struct seqlock *s, char *name)
+{
+  s->name = name;
+  s->seq = 0;
+}
+
+// start an update. the caller must hold the lock that
+// serializes writers.
+void
+seqwritebegin(struct seqlock *s)
+{
+  s->seq++;
+  __sync_synchronize();
+}
+
+void
+seqwriteend(struct seqlock *s)
+{
+  __sync_synchronize();
+  s->seq++;
+}
+
+// wait out any update in progress, and return the
+// sequence number to pass to seqretry().
+uint
+seqbegin(struct seqlock *s)
+{
+  uint seq;
+
+  while((seq = *(volatile uint*)&s->seq) & 1)
+    ;
+  __sync_synchronize();
+  return seq;
+}
+
+// did an update start since seqbegin() returned seq?
+int
+seqretry(struct seqlock *s, uint seq)
+{
+  __sync_synchronize();
+  return *(volatile uint*)&s->seq != seq;
+}
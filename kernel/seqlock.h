@@ -0,0 +1,8 @@
+// Sequence lock: writers bump seq before and after each
+// update, and readers retry if seq was odd or changed.
+struct seqlock {
+  uint seq;          // Odd while an update is in progress
+
+  // For debugging:
+  char *name;        // Name of lock.
+};
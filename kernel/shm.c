@@ -0,0 +1,64 @@
+// Shared memory segments.
+//
+// shmcreate() allocates a segment's pages and returns a file
+// descriptor for it; shmmap() maps those same physical pages
+// into the calling process. Each mapping, and the segment
+// itself, holds a kdup() reference to every page, so a page
+// goes back to kalloc() only when its last user lets go.
+// Mappings carry PTE_S, which tells fork() to share them
+// rather than copy them.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+
+// a segment's page list fits in one page.
+#define SHMMAXPG ((PGSIZE - sizeof(int)) / sizeof(uint64))
+
+struct shm {
+  int npages;
+  uint64 pa[SHMMAXPG];
+};
+
+// Allocate a zeroed segment of at least sz bytes.
+struct shm*
+shmalloc(uint64 sz)
+{
+  struct shm *sh;
+  char *mem;
+
+  if(sz == 0 || sz > SHMMAXPG * PGSIZE)
+    return 0;
+  if((sh = (struct shm*)kalloc()) == 0)
+    return 0;
+  for(sh->npages = 0; sh->npages < PGROUNDUP(sz) / PGSIZE; sh->npages++){
+    if((mem = kalloc()) == 0){
+      shmfree(sh);
+      return 0;
+    }
+    memset(mem, 0, PGSIZE);
+    sh->pa[sh->npages] = (uint64)mem;
+  }
+  return sh;
+}
+
+// Drop the segment's own references to its pages,
+// when the last file descriptor for it is closed.
+void
+shmfree(struct shm *sh)
+{
+  int i;
+
+  for(i = 0; i < sh->npages; i++)
+    kfree((void*)sh->pa[i]);
+  kfree((char*)sh);
+}
+
+// Map the segment into the current process.
+// Returns its user address, or -1.
+uint64
+shmmap(struct shm *sh)
+{
+  return growshared(sh->pa, sh->npages);
+}
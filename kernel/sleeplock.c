@@ -6,8 +6,8 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
-#include "proc.h"
 #include "sleeplock.h"
+#include "proc.h"
 
 void
 initsleeplock(struct sleeplock *lk, char *name)
@@ -15,6 +15,8 @@ initsleeplock(struct sleeplock *lk, char *name)
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->wwait = 0;
   lk->pid = 0;
 }
 
@@ -22,9 +24,11 @@ void
 acquiresleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
-  while (lk->locked) {
+  lk->wwait++;
+  while (lk->locked || lk->readers) {
     sleep(lk, &lk->lk);
   }
+  lk->wwait--;
   lk->locked = 1;
   lk->pid = myproc()->pid;
   release(&lk->lk);
@@ -40,6 +44,31 @@ releasesleep(struct sleeplock *lk)
   release(&lk->lk);
 }
 
+// Acquire lk shared with other shared holders, for code that
+// only reads what lk protects. New shared acquirers queue behind
+// a waiting exclusive one so that it isn't starved.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  while (lk->locked || lk->wwait) {
+    sleep(lk, &lk->lk);
+  }
+  lk->readers++;
+  release(&lk->lk);
+}
+
+void
+releasesleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(lk->readers < 1)
+    panic("releasesleepshared");
+  if(--lk->readers == 0)
+    wakeup(lk);
+  release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
@@ -5,15 +5,57 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
+#include "lockstat.h"
+
+// every initialized lock, for lockstat().
+static struct spinlock locks = { .name = "locks" };
 
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
   lk->locked = 0;
+  lk->ticket = 0;
+  lk->tnext = 0;
+  lk->towner = 0;
   lk->cpu = 0;
+  lk->nacquire = 0;
+  lk->nspin = 0;
+  lk->hold = 0;
+
+  acquire(&locks);
+  lk->prev = &locks;
+  lk->next = locks.next;
+  if(locks.next)
+    locks.next->prev = lk;
+  locks.next = lk;
+  release(&locks);
+}
+
+// Like initlock(), but acquire() takes a ticket and waits
+// for its turn, so CPUs get the lock in the order they asked
+// for it, and waiters only read the lock's cache line instead
+// of all writing it. For hot locks like kmem and bcache.
+void
+initticketlock(struct spinlock *lk, char *name)
+{
+  initlock(lk, name);
+  lk->ticket = 1;
+}
+
+// take lk off the list of locks, before freeing the
+// memory it's in.
+void
+freelock(struct spinlock *lk)
+{
+  acquire(&locks);
+  lk->prev->next = lk->next;
+  if(lk->next)
+    lk->next->prev = lk->prev;
+  release(&locks);
 }
 
 // Acquire the lock.
@@ -21,16 +63,27 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  struct cpu *c;
+  uint64 spins = 0;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  if(lk->ticket){
+    // On RISC-V, sync_fetch_and_add turns into amoadd.w.
+    uint t = __sync_fetch_and_add(&lk->tnext, 1);
+    while(*(volatile uint*)&lk->towner != t)
+      spins++;
+    lk->locked = 1;
+  } else {
+    // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+    //   a5 = 1
+    //   s1 = &lk->locked
+    //   amoswap.w.aq a5, a5, (s1)
+    while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+      spins++;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -39,7 +92,14 @@ acquire(struct spinlock *lk)
   __sync_synchronize();
 
   // Record info about lock acquisition for holding() and debugging.
-  lk->cpu = mycpu();
+  c = mycpu();
+  lk->cpu = c;
+
+  lk->nacquire++;
+  lk->nspin += spins;
+  lk->tacquire = r_time();
+  c->nacquire++;
+  c->nspin += spins;
 }
 
 // Release the lock.
@@ -50,6 +110,7 @@ release(struct spinlock *lk)
     panic("release");
 
   lk->cpu = 0;
+  lk->hold += r_time() - lk->tacquire;
 
   // Tell the C compiler and the CPU to not move loads or stores
   // past this point, to ensure that all the stores in the critical
@@ -59,6 +120,15 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
+  if(lk->ticket){
+    // let the next ticket in.
+    lk->locked = 0;
+    __sync_synchronize();
+    *(volatile uint*)&lk->towner = lk->towner + 1;
+    pop_off();
+    return;
+  }
+
   // Release the lock, equivalent to lk->locked = 0.
   // This code doesn't use a C assignment, since the C standard
   // implies that an assignment might be implemented with
@@ -108,3 +178,42 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// copy up to n struct lockstats to user address dst: one per
+// CPU, then one per lock. the counters are read without the
+// locks, so they may be slightly stale. returns the number of
+// records copied, or -1.
+int
+lockstats(uint64 dst, int n)
+{
+  struct lockstat ls;
+  struct spinlock *lk;
+  struct cpu *c;
+  int i;
+
+  for(i = 0; i < n && i < NCPU; i++){
+    c = &cpus[i];
+    memset(&ls, 0, sizeof(ls));
+    safestrcpy(ls.name, "cpu", sizeof(ls.name));
+    ls.name[3] = '0' + i;
+    ls.nacquire = c->nacquire;
+    ls.nspin = c->nspin;
+    if(copyout(myproc()->pagetable, dst + i*sizeof(ls), (char*)&ls, sizeof(ls)) < 0)
+      return -1;
+  }
+
+  acquire(&locks);
+  for(lk = locks.next; lk && i < n; lk = lk->next, i++){
+    memset(&ls, 0, sizeof(ls));
+    safestrcpy(ls.name, lk->name, sizeof(ls.name));
+    ls.nacquire = lk->nacquire;
+    ls.nspin = lk->nspin;
+    ls.hold = lk->hold;
+    if(copyout(myproc()->pagetable, dst + i*sizeof(ls), (char*)&ls, sizeof(ls)) < 0){
+      release(&locks);
+      return -1;
+    }
+  }
+  release(&locks);
+  return i;
+}
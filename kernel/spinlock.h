@@ -2,8 +2,20 @@
 struct spinlock {
   uint locked;       // Is the lock held?
 
+  // For ticket locks (see initticketlock()):
+  int ticket;        // Hand out tickets instead of test-and-set?
+  uint tnext;        // Next ticket to hand out.
+  uint towner;       // Ticket now holding the lock.
+
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  // Statistics, updated while holding the lock:
+  uint64 nacquire;   // Number of acquire()s.
+  uint64 nspin;      // Failed test-and-sets while spinning.
+  uint64 hold;       // Total time held, in time CSR units.
+  uint64 tacquire;   // When the holder acquired it.
+  struct spinlock *prev, *next;  // On the list of all locks.
 };
 
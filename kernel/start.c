@@ -10,11 +10,11 @@ void timerinit();
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
-// a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+// a scratch area per CPU for machinevec.
+uint64 mscratch0[NCPU][5];
 
-// assembly code in kernelvec.S for machine-mode timer interrupt.
-extern void timervec();
+// assembly code in kernelvec.S for machine-mode interrupts and ecalls.
+extern void machinevec();
 
 // entry.S jumps here in machine mode on stack0.
 void
@@ -33,8 +33,10 @@ start()
   // disable paging for now.
   w_satp(0);
 
-  // delegate all interrupts and exceptions to supervisor mode.
-  w_medeleg(0xffff);
+  // delegate all interrupts and exceptions to supervisor mode,
+  // except the supervisor's own ecalls, which ask machinevec
+  // to set the timer or interrupt another hart.
+  w_medeleg(0xffff & ~(1 << 9));
   w_mideleg(0xffff);
   w_sie(r_sie() | SIE_SEIE | SIE_STIE | SIE_SSIE);
 
@@ -43,6 +45,9 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor mode read the time CSR, for lock statistics.
+  w_mcounteren(r_mcounteren() | 2);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -54,9 +59,9 @@ start()
   asm volatile("mret");
 }
 
-// arrange to receive timer interrupts.
-// they will arrive in machine mode at
-// at timervec in kernelvec.S,
+// arrange to receive timer and software interrupts.
+// they will arrive in machine mode
+// at machinevec in kernelvec.S,
 // which turns them into software interrupts for
 // devintr() in trap.c.
 void
@@ -65,25 +70,26 @@ timerinit()
   // each CPU has a separate source of timer interrupts.
   int id = r_mhartid();
 
-  // ask the CLINT for a timer interrupt.
-  int interval = 1000000; // cycles; about 1/10th second in qemu.
-  *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
-
-  // prepare information in scratch[] for timervec.
-  // scratch[0..2] : space for timervec to save registers.
-  // scratch[3] : address of CLINT MTIMECMP register.
-  // scratch[4] : desired interval (in cycles) between timer interrupts.
-  uint64 *scratch = &timer_scratch[id][0];
-  scratch[3] = CLINT_MTIMECMP(id);
-  scratch[4] = interval;
+  // no timer interrupt until timer.c asks for one.
+  *(uint64*)CLINT_MTIMECMP(id) = -1;
+
+  // prepare information in scratch[] for machinevec.
+  // scratch[0..1] : space for machinevec to save registers.
+  // scratch[2] : address of this hart's CLINT MTIMECMP register.
+  // scratch[3] : address of this hart's CLINT MSIP register.
+  // scratch[4] : address of hart 0's CLINT MSIP register.
+  uint64 *scratch = &mscratch0[id][0];
+  scratch[2] = CLINT_MTIMECMP(id);
+  scratch[3] = CLINT_MSIP(id);
+  scratch[4] = CLINT_MSIP(0);
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
-  w_mtvec((uint64)timervec);
+  w_mtvec((uint64)machinevec);
 
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer and software interrupts.
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
 }
@@ -41,11 +41,46 @@ memmove(void *dst, const void *src, uint n)
   if(s < d && s + n > d){
     s += n;
     d += n;
+    if((((uint64)s ^ (uint64)d) & 7) == 0){
+      // same alignment: copy 8-byte words once d is aligned.
+      while(n > 0 && ((uint64)d & 7) != 0){
+        *--d = *--s;
+        n--;
+      }
+      while(n >= 8){
+        d -= 8;
+        s -= 8;
+        *(uint64*)d = *(const uint64*)s;
+        n -= 8;
+      }
+    }
     while(n-- > 0)
       *--d = *--s;
-  } else
+  } else {
+    if((((uint64)s ^ (uint64)d) & 7) == 0){
+      while(n > 0 && ((uint64)d & 7) != 0){
+        *d++ = *s++;
+        n--;
+      }
+      while(n >= 32){
+        ((uint64*)d)[0] = ((const uint64*)s)[0];
+        ((uint64*)d)[1] = ((const uint64*)s)[1];
+        ((uint64*)d)[2] = ((const uint64*)s)[2];
+        ((uint64*)d)[3] = ((const uint64*)s)[3];
+        d += 32;
+        s += 32;
+        n -= 32;
+      }
+      while(n >= 8){
+        *(uint64*)d = *(const uint64*)s;
+        d += 8;
+        s += 8;
+        n -= 8;
+      }
+    }
     while(n-- > 0)
       *d++ = *s++;
+  }
 
   return dst;
 }
@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
@@ -101,6 +102,23 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
+extern uint64 sys_dmesg(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_ioring_enter(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
+extern uint64 sys_lseek(void);
+extern uint64 sys_splice(void);
+extern uint64 sys_poll(void);
+extern uint64 sys_fcntl(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_futex(void);
+extern uint64 sys_shmcreate(void);
+extern uint64 sys_shmmap(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_clock_gettime(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -126,6 +144,23 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_dmesg]   sys_dmesg,
+[SYS_lockstat] sys_lockstat,
+[SYS_ioring_enter] sys_ioring_enter,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_lseek]   sys_lseek,
+[SYS_splice]  sys_splice,
+[SYS_poll]    sys_poll,
+[SYS_fcntl]   sys_fcntl,
+[SYS_clone]   sys_clone,
+[SYS_futex]   sys_futex,
+[SYS_shmcreate] sys_shmcreate,
+[SYS_shmmap]  sys_shmmap,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_clock_gettime] sys_clock_gettime,
 };
 
 void
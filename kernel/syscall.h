@@ -20,3 +20,20 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_dmesg  22
+#define SYS_lockstat 23
+#define SYS_ioring_enter 24
+#define SYS_readv  25
+#define SYS_writev 26
+#define SYS_pread  27
+#define SYS_pwrite 28
+#define SYS_lseek  29
+#define SYS_splice 30
+#define SYS_poll   31
+#define SYS_fcntl  32
+#define SYS_clone  33
+#define SYS_futex  34
+#define SYS_shmcreate 35
+#define SYS_shmmap 36
+#define SYS_nanosleep 37
+#define SYS_clock_gettime 38
@@ -10,14 +10,62 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "fs.h"
-#include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "ioring.h"
+#include "uio.h"
+#include "poll.h"
+#include "waitq.h"
+
+// Return the file open as fd, with a reference that the caller
+// must drop with fileclose(), or 0. clone()d threads share ofile,
+// and the reference stops another thread's close() from freeing
+// the file while this one uses it. The leader's memlock keeps
+// close() from emptying the slot between the look and filedup();
+// a process without threads has no one else to close it.
+static struct file*
+fdget(int fd)
+{
+  struct proc *p = myproc();
+  struct proc *l = p->leader;
+  struct file *f = 0;
+  int shared = l->nthread > 1;
+
+  if(shared)
+    acquiresleep(&l->memlock);
+  if(fd >= 0 && fd < p->nofile && (f = p->ofile[fd]) != 0)
+    filedup(f);
+  if(shared)
+    releasesleep(&l->memlock);
+  return f;
+}
+
+// Empty descriptor fd's slot, and return the file that was
+// there, whose reference passes to the caller, or 0. Of several
+// threads closing fd, only one gets the file.
+static struct file*
+fdtake(int fd)
+{
+  struct proc *p = myproc();
+  struct proc *l = p->leader;
+  struct file *f = 0;
+  int shared = l->nthread > 1;
+
+  if(shared)
+    acquiresleep(&l->memlock);
+  if(fd >= 0 && fd < p->nofile)
+    f = __sync_lock_test_and_set(&p->ofile[fd], 0);
+  if(shared)
+    releasesleep(&l->memlock);
+  return f;
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
+// and return both the descriptor and the corresponding struct file,
+// with a reference from fdget() that the caller must fileclose().
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
@@ -25,12 +73,14 @@ argfd(int n, int *pfd, struct file **pf)
   struct file *f;
 
   argint(n, &fd);
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((f = fdget(fd)) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
   if(pf)
     *pf = f;
+  else
+    fileclose(f);
   return 0;
 }
 
@@ -42,13 +92,17 @@ fdalloc(struct file *f)
   int fd;
   struct proc *p = myproc();
 
-  for(fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd] == 0){
-      p->ofile[fd] = f;
+  // clone()d threads share ofile, and may race for a slot.
+  for(fd = 0; fd < p->nofile; fd++){
+    if(__sync_bool_compare_and_swap(&p->ofile[fd], 0, f))
       return fd;
-    }
   }
-  return -1;
+  // all in use; make room for more. threads share a table
+  // that clone() has already grown, so this is unshared.
+  if(growfds(p) < 0)
+    return -1;
+  p->ofile[fd] = f;
+  return fd;
 }
 
 uint64
@@ -59,9 +113,10 @@ sys_dup(void)
 
   if(argfd(0, 0, &f) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  if((fd=fdalloc(f)) < 0){
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
@@ -69,21 +124,175 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
   argaddr(1, &p);
   argint(2, &n);
   if(argfd(0, 0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_pread(void)
+{
+  struct file *f;
+  int n, off, r;
+  uint64 p;
+
+  argaddr(1, &p);
+  argint(2, &n);
+  argint(3, &off);
+  if(off < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filepread(f, p, n, off);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off, r;
+  uint64 p;
+
+  argaddr(1, &p);
+  argint(2, &n);
+  argint(3, &off);
+  if(off < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filepwrite(f, p, n, off);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence, r;
+
+  argint(1, &off);
+  argint(2, &whence);
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  r = fileseek(f, off, whence);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n, r;
+
+  argint(2, &n);
+  if(argfd(0, 0, &in) < 0)
+    return -1;
+  if(argfd(1, 0, &out) < 0){
+    fileclose(in);
+    return -1;
+  }
+  r = filesplice(in, out, n);
+  fileclose(in);
+  fileclose(out);
+  return r;
+}
+
+uint64
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg, mode, r;
+
+  argint(1, &cmd);
+  argint(2, &arg);
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  r = -1;
+  switch(cmd){
+  case F_GETFL:
+    if(f->readable && f->writable)
+      mode = O_RDWR;
+    else if(f->writable)
+      mode = O_WRONLY;
+    else
+      mode = O_RDONLY;
+    r = mode | (f->nonblock ? O_NONBLOCK : 0);
+    break;
+  case F_SETFL:
+    f->nonblock = (arg & O_NONBLOCK) != 0;
+    r = 0;
+    break;
+  }
+  fileclose(f);
+  return r;
+}
+
+// fetch the iovec array for readv() or writev() into iov,
+// checking that the total length fits in an int.
+static int
+argiov(int n, struct iovec *iov, int *piovcnt)
+{
+  uint64 uiov, tot;
+  int i, iovcnt;
+
+  argaddr(n, &uiov);
+  argint(n+1, &iovcnt);
+  if(iovcnt < 0 || iovcnt > UIO_MAXIOV)
+    return -1;
+  if(copyin(myproc()->pagetable, (char*)iov, uiov, iovcnt*sizeof(struct iovec)) < 0)
+    return -1;
+  tot = 0;
+  for(i = 0; i < iovcnt; i++){
+    if(iov[i].iov_len > 0x7fffffff)
+      return -1;
+    tot += iov[i].iov_len;
+  }
+  if(tot > 0x7fffffff)
+    return -1;
+  *piovcnt = iovcnt;
+  return 0;
+}
+
+uint64
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[UIO_MAXIOV];
+  int iovcnt, r;
+
+  if(argiov(1, iov, &iovcnt) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filereadv(f, iov, iovcnt);
+  fileclose(f);
+  return r;
+}
+
+uint64
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[UIO_MAXIOV];
+  int iovcnt, r;
+
+  if(argiov(1, iov, &iovcnt) < 0 || argfd(0, 0, &f) < 0)
+    return -1;
+  r = filewritev(f, iov, iovcnt);
+  fileclose(f);
+  return r;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
   
   argaddr(1, &p);
@@ -91,7 +300,9 @@ sys_write(void)
   if(argfd(0, 0, &f) < 0)
     return -1;
 
-  return filewrite(f, p, n);
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
@@ -100,9 +311,9 @@ sys_close(void)
   int fd;
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  argint(0, &fd);
+  if((f = fdtake(fd)) == 0)
     return -1;
-  myproc()->ofile[fd] = 0;
   fileclose(f);
   return 0;
 }
@@ -112,11 +323,14 @@ sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int r;
 
   argaddr(1, &st);
   if(argfd(0, 0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -222,6 +436,7 @@ sys_unlink(void)
   memset(&de, 0, sizeof(de));
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
     panic("unlink: writei");
+  dcacheremove(dp, name);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -301,18 +516,13 @@ create(char *path, short type, short major, short minor)
   return 0;
 }
 
-uint64
-sys_open(void)
+// open path, for sys_open() and IORING_OP_OPEN.
+static int
+fileopen(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  argint(1, &omode);
-  if((n = argstr(0, path, MAXPATH)) < 0)
-    return -1;
 
   begin_op();
 
@@ -359,6 +569,7 @@ sys_open(void)
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->nonblock = (omode & O_NONBLOCK) != 0;
 
   if((omode & O_TRUNC) && ip->type == T_FILE){
     itrunc(ip);
@@ -370,6 +581,18 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  argint(1, &omode);
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+  return fileopen(path, omode);
+}
+
 uint64
 sys_mkdir(void)
 {
@@ -488,18 +711,232 @@ sys_pipe(void)
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
     if(fd0 >= 0)
-      p->ofile[fd0] = 0;
+      fdtake(fd0);
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
+    fdtake(fd0);
+    fdtake(fd1);
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   return 0;
 }
+
+// create a shared memory segment of n bytes,
+// and return a file descriptor for it.
+uint64
+sys_shmcreate(void)
+{
+  int n, fd;
+  struct shm *sh;
+  struct file *f;
+
+  argint(0, &n);
+  if(n <= 0 || (sh = shmalloc(n)) == 0)
+    return -1;
+  if((f = filealloc()) == 0){
+    shmfree(sh);
+    return -1;
+  }
+  f->type = FD_SHM;
+  f->readable = 0;
+  f->writable = 0;
+  f->shm = sh;
+  if((fd = fdalloc(f)) < 0){
+    fileclose(f);
+    return -1;
+  }
+  return fd;
+}
+
+// map the shared memory segment open as fd into this
+// process, and return its address.
+uint64
+sys_shmmap(void)
+{
+  struct file *f;
+
+  uint64 va;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  va = f->type == FD_SHM ? shmmap(f->shm) : -1;
+  fileclose(f);
+  return va;
+}
+
+// carry out one submission queue entry, and return what the
+// equivalent system call would have.
+static int
+ioring_op(struct iosqe *sqe)
+{
+  struct file *f;
+  char path[MAXPATH];
+  int r;
+
+  if(sqe->op == IORING_OP_OPEN){
+    if(fetchstr(sqe->addr, path, MAXPATH) < 0)
+      return -1;
+    return fileopen(path, sqe->len);
+  }
+
+  if(sqe->op == IORING_OP_CLOSE){
+    if((f = fdtake(sqe->fd)) == 0)
+      return -1;
+    fileclose(f);
+    return 0;
+  }
+
+  if((f = fdget(sqe->fd)) == 0)
+    return -1;
+  r = -1;
+  switch(sqe->op){
+  case IORING_OP_READ:
+    r = fileread(f, sqe->addr, sqe->len);
+    break;
+  case IORING_OP_WRITE:
+    r = filewrite(f, sqe->addr, sqe->len);
+    break;
+  }
+  fileclose(f);
+  return r;
+}
+
+// ioring_enter(ring, n): carry out up to n queued operations
+// from the ring at user address ring, in one system call.
+// the kernel uses the ring's page through its physical address,
+// found afresh each time, since the process may free it.
+// returns how many operations were consumed, or -1.
+uint64
+sys_ioring_enter(void)
+{
+  uint64 va, pa;
+  struct ioring *r;
+  struct iosqe sqe;
+  struct iocqe *cqe;
+  int n, done, res;
+
+  argaddr(0, &va);
+  argint(1, &n);
+  if(va % PGSIZE != 0 || va >= myproc()->sz)
+    return -1;
+  // the kernel writes the ring through its physical address,
+  // so it must be writable by the process.
+  if((pa = walkaddrw(myproc()->pagetable, va)) == 0)
+    return -1;
+  r = (struct ioring*)pa;
+
+  for(done = 0; done < n; done++){
+    __sync_synchronize();
+    if(r->sqhead == r->sqtail)
+      break;
+    if(r->cqtail - r->cqhead >= IORING_NCQ)
+      break;  // no room for the result
+    sqe = r->sq[r->sqhead % IORING_NSQ];
+    r->sqhead++;
+
+    // ioring_op() may sleep, and the process could free the
+    // ring's page meanwhile; look it up again afterwards.
+    res = ioring_op(&sqe);
+    if((pa = walkaddrw(myproc()->pagetable, va)) == 0)
+      return -1;
+    r = (struct ioring*)pa;
+
+    cqe = &r->cq[r->cqtail % IORING_NCQ];
+    cqe->data = sqe.data;
+    cqe->res = res;
+    __sync_synchronize();
+    r->cqtail++;
+  }
+  return done;
+}
+
+// poll()'s state, too big for the kernel stack.
+struct pollstate {
+  struct pollfd fds[POLLMAX];
+  struct file *f[POLLMAX];     // a reference to each fds[i].fd's file
+  struct pollent e[POLLMAX];   // f[i]'s place on its wait queue
+  struct pollent tick;         // place on tickwq, for a timeout
+};
+
+// Wait until one of nfds descriptors is ready or timeout ticks
+// have passed; a negative timeout waits for ever. Returns the
+// number of descriptors with revents set.
+uint64
+sys_poll(void)
+{
+  struct proc *p = myproc();
+  struct pollstate *ps;
+  uint64 ufds;
+  int nfds, timeout, i, fd, n, ev;
+  uint deadline;
+
+  argaddr(0, &ufds);
+  argint(1, &nfds);
+  argint(2, &timeout);
+  if(nfds < 0 || nfds > POLLMAX)
+    return -1;
+  if((ps = (struct pollstate*)kalloc()) == 0)
+    return -1;
+  if(copyin(p->pagetable, (char*)ps->fds, ufds, nfds*sizeof(struct pollfd)) < 0){
+    kfree((char*)ps);
+    return -1;
+  }
+  for(i = 0; i < nfds; i++){
+    fd = ps->fds[i].fd;
+    ps->f[i] = 0;
+    ps->e[i].q = 0;
+    ps->f[i] = fdget(fd);
+  }
+  ps->tick.q = 0;
+
+  acquire(&tickslock);
+  deadline = ticks + timeout;
+  release(&tickslock);
+
+  for(;;){
+    pollarm();
+    n = 0;
+    for(i = 0; i < nfds; i++){
+      if(ps->fds[i].fd < 0)
+        ev = 0;
+      else if(ps->f[i] == 0)
+        ev = POLLNVAL;
+      else
+        ev = filepoll(ps->f[i], &ps->e[i]) & (ps->fds[i].events|POLLERR|POLLHUP);
+      ps->fds[i].revents = ev;
+      if(ev)
+        n++;
+    }
+    if(n > 0 || timeout == 0)
+      break;
+    if(timeout > 0){
+      acquire(&tickslock);
+      pollwait(&tickwq, &ps->tick);
+      ev = (int)(ticks - deadline) >= 0;
+      release(&tickslock);
+      if(ev)
+        break;
+    }
+    if(pollsleep() < 0){
+      n = -1;
+      break;
+    }
+  }
+
+  pollunwait(&ps->tick);
+  for(i = 0; i < nfds; i++){
+    pollunwait(&ps->e[i]);
+    if(ps->f[i])
+      fileclose(ps->f[i]);
+  }
+  if(n >= 0 && copyout(p->pagetable, ufds, (char*)ps->fds, nfds*sizeof(struct pollfd)) < 0)
+    n = -1;
+  kfree((char*)ps);
+  return n;
+}
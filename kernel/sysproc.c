@@ -4,7 +4,11 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "seqlock.h"
+#include "sleeplock.h"
 #include "proc.h"
+#include "futex.h"
+#include "time.h"
 
 uint64
 sys_exit(void)
@@ -18,7 +22,9 @@ sys_exit(void)
 uint64
 sys_getpid(void)
 {
-  return myproc()->pid;
+  // threads answer for their process, as the
+  // USYSCALL page they share does.
+  return myproc()->leader->pid;
 }
 
 uint64
@@ -42,8 +48,7 @@ sys_sbrk(void)
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  if(growproc(n, &addr) < 0)
     return -1;
   return addr;
 }
@@ -68,6 +73,70 @@ sys_sleep(void)
   return 0;
 }
 
+// sleep for a struct timespec, to the nearest CLINT_MTIME
+// cycle rather than the nearest tick.
+uint64
+sys_nanosleep(void)
+{
+  uint64 addr;
+  struct timespec ts;
+
+  argaddr(0, &addr);
+  if(copyin(myproc()->pagetable, (char*)&ts, addr, sizeof(ts)) < 0)
+    return -1;
+  if(ts.tv_nsec >= 1000000000)
+    return -1;
+  // the deadline r_time() + n must not wrap around to the past;
+  // >= leaves a second for tv_nsec.
+  if(ts.tv_sec >= (~0ULL - r_time()) / MTIME_HZ)
+    return -1;
+  return timersleep(ts.tv_sec * MTIME_HZ +
+                    (ts.tv_nsec * MTIME_HZ + 999999999) / 1000000000);
+}
+
+// the time since boot, from the CLINT_MTIME counter.
+uint64
+sys_clock_gettime(void)
+{
+  uint64 addr, t;
+  struct timespec ts;
+
+  argaddr(0, &addr);
+  t = r_time();
+  ts.tv_sec = t / MTIME_HZ;
+  ts.tv_nsec = (t % MTIME_HZ) * 1000000000 / MTIME_HZ;
+  if(copyout(myproc()->pagetable, addr, (char*)&ts, sizeof(ts)) < 0)
+    return -1;
+  return 0;
+}
+
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_futex(void)
+{
+  uint64 addr;
+  int op, val;
+
+  argaddr(0, &addr);
+  argint(1, &op);
+  argint(2, &val);
+  if(op == FUTEX_WAIT)
+    return futexwait(addr, val);
+  if(op == FUTEX_WAKE)
+    return futexwake(addr, val);
+  return -1;
+}
+
 uint64
 sys_kill(void)
 {
@@ -82,10 +151,36 @@ sys_kill(void)
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  uint xticks, seq;
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
+  do {
+    seq = seqbegin(&tickseq);
+    xticks = ticks;
+  } while(seqretry(&tickseq, seq));
   return xticks;
 }
+
+// copy the tail of the kernel log to a user buffer.
+uint64
+sys_dmesg(void)
+{
+  uint64 buf;
+  int n;
+
+  argaddr(0, &buf);
+  argint(1, &n);
+  return logread(buf, n);
+}
+
+// copy per-CPU and per-lock statistics to a user array
+// of struct lockstat.
+uint64
+sys_lockstat(void)
+{
+  uint64 buf;
+  int n;
+
+  argaddr(0, &buf);
+  argint(1, &n);
+  return lockstats(buf, n);
+}
@@ -0,0 +1,5 @@
+// a time for clock_gettime() and nanosleep().
+struct timespec {
+  uint64 tv_sec;   // seconds
+  uint64 tv_nsec;  // and nanoseconds, below 1000000000
+};
@@ -0,0 +1,229 @@
+// Timers, and the one-shot hardware timer that runs them.
+//
+// Each hart's CLINT MTIMECMP register is set only for the next
+// thing that hart must do: CPU 0 takes every timerq deadline,
+// including the clock tick, and any CPU running a process
+// wants the end of its time slice. An idle CPU other than 0
+// therefore takes no timer interrupts at all; it sleeps in
+// wfi until kickidle() sends it a software interrupt because
+// a process has become RUNNABLE.
+//
+// Only machine mode can write MTIMECMP or send interrupts to
+// other harts, so the kernel asks machinevec in kernelvec.S
+// with an ecall.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "timer.h"
+#include "defs.h"
+
+#define TICK (MTIME_HZ / 10)   // the clock tick, about 1/10th second
+#define SLICE TICK             // time a process may run before yielding
+
+#define MCALL_SETTIMER 0       // a0: next interrupt, in CLINT_MTIME units
+#define MCALL_IPI      1       // a0: hart to send a software interrupt
+
+// pending timers, earliest first. CPU 0 keeps its hardware
+// timer set for the first one.
+struct {
+  struct spinlock lock;
+  struct timer *head;
+} timerq;
+
+static struct timer ticktimer;
+
+static void
+mcall(uint64 fn, uint64 arg)
+{
+  register uint64 a0 asm("a0") = arg;
+  register uint64 a7 asm("a7") = fn;
+
+  asm volatile("ecall" : "+r" (a0) : "r" (a7) : "memory");
+}
+
+// set this hart's timer for the earliest of its time slice and,
+// on CPU 0, the first pending timer. On CPU 0 the caller holds
+// timerq.lock. interrupts must be off.
+static void
+arm(void)
+{
+  struct cpu *c = mycpu();
+  uint64 when = -1;
+
+  if(cpuid() == 0 && timerq.head)
+    when = timerq.head->when;
+  if(c->slice != 0 && c->slice < when)
+    when = c->slice;
+  if(when != c->armed){
+    c->armed = when;
+    mcall(MCALL_SETTIMER, when);
+  }
+}
+
+void
+timerarm(void)
+{
+  push_off();
+  if(cpuid() == 0){
+    acquire(&timerq.lock);
+    arm();
+    release(&timerq.lock);
+  } else {
+    arm();
+  }
+  pop_off();
+}
+
+// put t on timerq, to call fn(arg) at CLINT_MTIME when.
+// caller holds timerq.lock.
+static void
+insert(struct timer *t, uint64 when, void (*fn)(void*), void *arg)
+{
+  struct timer **pp;
+
+  t->when = when;
+  t->fn = fn;
+  t->arg = arg;
+  t->pending = 1;
+  for(pp = &timerq.head; *pp && (*pp)->when <= when; pp = &(*pp)->next)
+    ;
+  t->next = *pp;
+  *pp = t;
+
+  // CPU 0 must see a new first deadline.
+  if(timerq.head == t){
+    push_off();
+    if(cpuid() == 0)
+      arm();
+    else if(when < *(volatile uint64*)&cpus[0].armed)
+      mcall(MCALL_IPI, 0);
+    pop_off();
+  }
+}
+
+// take t off timerq, if it is there.
+// caller holds timerq.lock.
+static void
+remove(struct timer *t)
+{
+  struct timer **pp;
+
+  if(!t->pending)
+    return;
+  for(pp = &timerq.head; *pp != t; pp = &(*pp)->next)
+    ;
+  *pp = t->next;
+  t->pending = 0;
+}
+
+static void
+tick(void *arg)
+{
+  clockintr();
+  acquire(&timerq.lock);
+  insert(&ticktimer, ticktimer.when + TICK, tick, 0);
+  release(&timerq.lock);
+}
+
+void
+timerqinit(void)
+{
+  initlock(&timerq.lock, "timerq");
+  acquire(&timerq.lock);
+  insert(&ticktimer, r_time() + TICK, tick, 0);
+  release(&timerq.lock);
+}
+
+// a timer or software interrupt, via machinevec.
+// run the timers that are due, and set the next interrupt.
+// interrupts are off.
+void
+timerintr(void)
+{
+  struct timer *t;
+  void (*fn)(void*);
+  void *arg;
+
+  // machinevec has stopped this hart's timer.
+  mycpu()->armed = -1;
+
+  if(cpuid() != 0){
+    arm();
+    return;
+  }
+
+  acquire(&timerq.lock);
+  while((t = timerq.head) != 0 && t->when <= r_time()){
+    timerq.head = t->next;
+    t->pending = 0;
+    // t may be gone once the lock is released.
+    fn = t->fn;
+    arg = t->arg;
+    release(&timerq.lock);
+    fn(arg);
+    acquire(&timerq.lock);
+  }
+  arm();
+  release(&timerq.lock);
+}
+
+// start the time slice of the process this CPU is about to run.
+void
+timerslice(void)
+{
+  push_off();
+  mycpu()->slice = r_time() + SLICE;
+  pop_off();
+  timerarm();
+}
+
+// a process has become RUNNABLE: wake an idle CPU to run it.
+void
+kickidle(void)
+{
+  int i, me;
+
+  push_off();
+  me = cpuid();
+  for(i = 0; i < NCPU; i++){
+    if(i != me && *(volatile int*)&cpus[i].idle &&
+       __sync_lock_test_and_set(&cpus[i].idle, 0)){
+      mcall(MCALL_IPI, i);
+      break;
+    }
+  }
+  pop_off();
+}
+
+static void
+wakesleeper(void *chan)
+{
+  wakeup(chan);
+}
+
+// sleep for n units of CLINT_MTIME.
+// returns -1 if killed first.
+int
+timersleep(uint64 n)
+{
+  struct timer t;
+  int r = 0;
+
+  acquire(&timerq.lock);
+  insert(&t, r_time() + n, wakesleeper, &t);
+  while(t.pending){
+    if(killed(myproc())){
+      remove(&t);
+      r = -1;
+      break;
+    }
+    sleep(&t, &timerq.lock);
+  }
+  release(&timerq.lock);
+  return r;
+}
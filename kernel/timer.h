@@ -0,0 +1,9 @@
+// A function to call once CLINT_MTIME reaches when.
+// Pending timers sit on timer.c's timerq, earliest first.
+struct timer {
+  uint64 when;
+  void (*fn)(void*);   // called with interrupts off
+  void *arg;
+  int pending;         // on timerq?
+  struct timer *next;
+};
@@ -3,23 +3,38 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "seqlock.h"
+#include "waitq.h"
+#include "sleeplock.h"
 #include "proc.h"
+#include "usyscall.h"
 #include "defs.h"
 
 struct spinlock tickslock;
+struct seqlock tickseq;    // lets sys_uptime() read ticks without tickslock
 uint ticks;
+struct waitq tickwq;       // poll()s with a timeout
+struct utime *utime;       // ticks for user space, mapped at UTIME
 
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
+// in copyuser.S.
+extern char copyuser_end[], copyuser_fault[];
+
 extern int devintr();
 
 void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  initseqlock(&tickseq, "time");
+  initwaitq(&tickwq, "tickwq");
+  if((utime = (struct utime*)kalloc()) == 0)
+    panic("trapinit: utime");
+  memset(utime, 0, PGSIZE);
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -45,6 +60,9 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
 
+  // user code can't be in an RCU read-side section.
+  rcuquiescent();
+
   struct proc *p = myproc();
   
   // save user program counter.
@@ -102,7 +120,8 @@ usertrapret(void)
 
   // set up trapframe values that uservec will need when
   // the process next traps into the kernel.
-  p->trapframe->kernel_satp = r_satp();         // kernel page table
+  uint64 asid = proc_asid(p);                   // tags p's page tables
+  p->trapframe->kernel_satp = proc_ksatp(p, asid); // kernel page table
   p->trapframe->kernel_sp = p->kstack + PGSIZE; // process's kernel stack
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();         // hartid for cpuid()
@@ -113,20 +132,23 @@ usertrapret(void)
   // set S Previous Privilege mode to User.
   unsigned long x = r_sstatus();
   x &= ~SSTATUS_SPP; // clear SPP to 0 for user mode
+  x &= ~SSTATUS_SUM; // in case copyuser() was preempted
   x |= SSTATUS_SPIE; // enable interrupts in user mode
   w_sstatus(x);
 
   // set S Exception Program Counter to the saved user pc.
   w_sepc(p->trapframe->epc);
 
-  // tell trampoline.S the user page table to switch to.
-  uint64 satp = MAKE_SATP(p->pagetable);
+  // tell trampoline.S the user page table to switch to,
+  // tagged with p's ASID.
+  uint64 satp = MAKE_SATP_ASID(p->pagetable, asid);
 
   // jump to userret in trampoline.S at the top of memory, which 
-  // switches to the user page table, restores user registers,
-  // and switches to user mode with sret.
+  // switches to the user page table, restores user registers
+  // from the trapframe at p->tfva, and switches to user mode
+  // with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64))trampoline_userret)(satp);
+  ((void (*)(uint64, uint64))trampoline_userret)(satp, p->tfva);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -145,9 +167,15 @@ kerneltrap()
     panic("kerneltrap: interrupts enabled");
 
   if((which_dev = devintr()) == 0){
-    printf("scause %p\n", scause);
-    printf("sepc=%p stval=%p\n", r_sepc(), r_stval());
-    panic("kerneltrap");
+    if((scause == 13 || scause == 15) &&
+       sepc >= (uint64)copyuser && sepc < (uint64)copyuser_end){
+      // a bad user address in copyuser(); make it return -1.
+      sepc = (uint64)copyuser_fault;
+    } else {
+      printf("scause %p\n", scause);
+      printf("sepc=%p stval=%p\n", r_sepc(), r_stval());
+      panic("kerneltrap");
+    }
   }
 
   // give up the CPU if this is a timer interrupt.
@@ -160,13 +188,19 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// the clock tick, which timer.c runs every TICK.
 void
 clockintr()
 {
   acquire(&tickslock);
+  seqwritebegin(&tickseq);
   ticks++;
+  utime->ticks = ticks;
+  seqwriteend(&tickseq);
   wakeup(&ticks);
+  wakeq(&tickwq);
   release(&tickslock);
+  logdrain();
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -202,17 +236,16 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt from a machine-mode timer or
+    // software interrupt, forwarded by machinevec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip, before timerintr() sets the
+    // timer for the next one.
     w_sip(r_sip() & ~2);
 
+    timerintr();
+
     return 2;
   } else {
     return 0;
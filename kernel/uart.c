@@ -7,6 +7,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
 
@@ -34,13 +35,14 @@
 #define LSR 5                 // line status register
 #define LSR_RX_READY (1<<0)   // input is waiting to be read from RHR
 #define LSR_TX_IDLE (1<<5)    // THR can accept another character to send
+#define UART_FIFO_SIZE 16     // with FIFOs on, TX_IDLE means 16 bytes free
 
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
 // the transmit output buffer.
 struct spinlock uart_tx_lock;
-#define UART_TX_BUF_SIZE 32
+#define UART_TX_BUF_SIZE 1024
 char uart_tx_buf[UART_TX_BUF_SIZE];
 uint64 uart_tx_w; // write next to uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE]
 uint64 uart_tx_r; // read next from uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]
@@ -103,6 +105,60 @@ uartputc(int c)
   release(&uart_tx_lock);
 }
 
+// add n characters from buf to the output buffer, taking
+// the lock once per buffer-full rather than per character.
+// blocks while the output buffer is full, so like
+// uartputc() it's only suitable for use by write().
+void
+uartwrite(char *buf, int n)
+{
+  int i;
+
+  acquire(&uart_tx_lock);
+
+  if(panicked){
+    for(;;)
+      ;
+  }
+  i = 0;
+  while(i < n){
+    while(uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE){
+      // buffer is full.
+      // wait for uartstart() to open up space in the buffer.
+      sleep(&uart_tx_r, &uart_tx_lock);
+    }
+    while(i < n && uart_tx_w != uart_tx_r + UART_TX_BUF_SIZE){
+      uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = buf[i++];
+      uart_tx_w += 1;
+    }
+    uartstart();
+  }
+  release(&uart_tx_lock);
+}
+
+
+// like uartwrite(), but never sleeps: adds as many of the
+// n characters as fit in the output buffer, and returns how
+// many that was. for logdrain(), which runs in interrupts.
+int
+uarttrywrite(char *buf, int n)
+{
+  int i;
+
+  acquire(&uart_tx_lock);
+
+  if(panicked){
+    for(;;)
+      ;
+  }
+  for(i = 0; i < n && uart_tx_w != uart_tx_r + UART_TX_BUF_SIZE; i++){
+    uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = buf[i];
+    uart_tx_w += 1;
+  }
+  uartstart();
+  release(&uart_tx_lock);
+  return i;
+}
 
 // alternate version of uartputc() that doesn't 
 // use interrupts, for use by kernel printf() and
@@ -133,26 +189,33 @@ uartputc_sync(int c)
 void
 uartstart()
 {
+  uint64 r0 = uart_tx_r;
+
   while(1){
     if(uart_tx_w == uart_tx_r){
       // transmit buffer is empty.
-      return;
+      break;
     }
     
     if((ReadReg(LSR) & LSR_TX_IDLE) == 0){
       // the UART transmit holding register is full,
       // so we cannot give it another byte.
       // it will interrupt when it's ready for a new byte.
-      return;
+      break;
     }
     
-    int c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
-    uart_tx_r += 1;
-    
-    // maybe uartputc() is waiting for space in the buffer.
+    // the transmit FIFO is empty, so fill all of it.
+    for(int i = 0; i < UART_FIFO_SIZE && uart_tx_w != uart_tx_r; i++){
+      int c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
+      uart_tx_r += 1;
+      WriteReg(THR, c);
+    }
+  }
+
+  if(uart_tx_r != r0){
+    // maybe uartputc() or uartwrite() is waiting for
+    // space in the buffer.
     wakeup(&uart_tx_r);
-    
-    WriteReg(THR, c);
   }
 }
 
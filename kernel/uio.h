@@ -0,0 +1,7 @@
+// A piece of a user buffer for readv() and writev().
+struct iovec {
+  void *iov_base;
+  uint64 iov_len;
+};
+
+#define UIO_MAXIOV 16  // most iovecs per call
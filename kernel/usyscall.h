@@ -0,0 +1,13 @@
+// Pages that the kernel maps read-only into user space,
+// so that user code can read these with plain loads
+// instead of system calls (see user/ulib.c).
+
+// at USYSCALL, one per process.
+struct usyscall {
+  int pid;      // getpid()
+};
+
+// at UTIME, one page that all processes share.
+struct utime {
+  uint ticks;   // uptime(); clockintr() updates it
+};
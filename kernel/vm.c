@@ -3,6 +3,9 @@
 #include "memlayout.h"
 #include "elf.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 
@@ -70,9 +73,64 @@ kvminithart()
   sfence_vma();
 }
 
+#ifdef KVMUSER
+// Make a kernel page table for a process. It shares all of
+// kernel_pagetable's page-table pages except the top one and
+// the level-1 page for the bottom gigabyte, where user memory
+// sits below the device registers; kvmmapuser() fills in the
+// user part of that one.
+// Returns 0 if out of memory.
+pagetable_t
+kvmcreate(void)
+{
+  pagetable_t kpgtbl, l1;
+
+  if((kpgtbl = (pagetable_t) kalloc()) == 0)
+    return 0;
+  if((l1 = (pagetable_t) kalloc()) == 0){
+    kfree(kpgtbl);
+    return 0;
+  }
+  memmove(kpgtbl, kernel_pagetable, PGSIZE);
+  memmove(l1, (void*)PTE2PA(kernel_pagetable[0]), PGSIZE);
+  kpgtbl[0] = PA2PTE(l1) | PTE_V;
+  return kpgtbl;
+}
+
+// Point the user part of kernel page table kpgtbl at the
+// page-table pages (and megapages) of user page table
+// upgtbl that map addresses below MAXUVA. The level-0 pages
+// are shared, so only changes to upgtbl's level-1 entries,
+// such as a new page-table page or a split megapage, need
+// another call.
+void
+kvmmapuser(pagetable_t kpgtbl, pagetable_t upgtbl)
+{
+  pagetable_t kl1, ul1;
+
+  kl1 = (pagetable_t)PTE2PA(kpgtbl[0]);
+  ul1 = (upgtbl[0] & PTE_V) ? (pagetable_t)PTE2PA(upgtbl[0]) : 0;
+  for(int i = 0; i < MAXUVA / MEGAPGSIZE; i++)
+    kl1[i] = ul1 ? ul1[i] : 0;
+}
+
+// Free a kernel page table made by kvmcreate(),
+// but none of the pages it shares.
+void
+kvmfree(pagetable_t kpgtbl)
+{
+  kfree((void*)PTE2PA(kpgtbl[0]));
+  kfree((void*)kpgtbl);
+}
+#endif
+
 // Return the address of the PTE in page table pagetable
-// that corresponds to virtual address va.  If alloc!=0,
-// create any required page-table pages.
+// that corresponds to virtual address va, stopping at
+// page-table level target (0 for a 4096-byte page, 1 for
+// a 2-megabyte megapage). If alloc!=0, create any required
+// page-table pages. If va is already covered by a leaf PTE
+// at a higher level (a superpage), return that PTE instead.
+// If levelp is non-zero, store the level of the returned PTE.
 //
 // The risc-v Sv39 scheme has three levels of page-table
 // pages. A page-table page contains 512 64-bit PTEs.
@@ -82,15 +140,21 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
-pte_t *
-walk(pagetable_t pagetable, uint64 va, int alloc)
+static pte_t *
+walklevel(pagetable_t pagetable, uint64 va, int alloc, int target, int *levelp)
 {
   if(va >= MAXVA)
     panic("walk");
 
-  for(int level = 2; level > 0; level--) {
+  for(int level = 2; level > target; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
     if(*pte & PTE_V) {
+      if(PTE_LEAF(*pte)){
+        // a superpage covers va.
+        if(levelp)
+          *levelp = level;
+        return pte;
+      }
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
@@ -99,40 +163,91 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
-  return &pagetable[PX(0, va)];
+  if(levelp)
+    *levelp = target;
+  return &pagetable[PX(target, va)];
 }
 
-// Look up a virtual address, return the physical address,
-// or 0 if not mapped.
-// Can only be used to look up user pages.
-uint64
-walkaddr(pagetable_t pagetable, uint64 va)
+// Return the address of the leaf PTE in page table pagetable
+// that corresponds to virtual address va.  If alloc!=0,
+// create any required page-table pages. The PTE is usually
+// a level-0 PTE, but may be a level-1 megapage PTE.
+pte_t *
+walk(pagetable_t pagetable, uint64 va, int alloc)
+{
+  return walklevel(pagetable, va, alloc, 0, 0);
+}
+
+// Look up a virtual address whose PTE has all of perm,
+// return the physical address, or 0 if not mapped.
+static uint64
+walkaddrperm(pagetable_t pagetable, uint64 va, int perm)
 {
   pte_t *pte;
   uint64 pa;
+  int level;
 
   if(va >= MAXVA)
     return 0;
 
-  pte = walk(pagetable, va, 0);
+  pte = walklevel(pagetable, va, 0, 0, &level);
   if(pte == 0)
     return 0;
   if((*pte & PTE_V) == 0)
     return 0;
-  if((*pte & PTE_U) == 0)
+  if((*pte & perm) != perm)
     return 0;
-  pa = PTE2PA(*pte);
+  // for a superpage, the 4096-byte page within it that holds va.
+  pa = PTE2PA(*pte) + (PGROUNDDOWN(va) & (PXSIZE(level) - 1));
   return pa;
 }
 
+// Look up a virtual address, return the physical address,
+// or 0 if not mapped.
+// Can only be used to look up user pages.
+uint64
+walkaddr(pagetable_t pagetable, uint64 va)
+{
+  return walkaddrperm(pagetable, va, PTE_U);
+}
+
+// Like walkaddr(), but for a page the kernel will write
+// to on the user's behalf: 0 unless it is user-writable.
+uint64
+walkaddrw(pagetable_t pagetable, uint64 va)
+{
+  return walkaddrperm(pagetable, va, PTE_U | PTE_W);
+}
+
 // add a mapping to the kernel page table.
 // only used when booting.
 // does not flush TLB or enable paging.
+// uses megapages for the parts of the range where
+// va and pa are both megapage-aligned, which saves
+// page-table pages and TLB entries for the big
+// direct map of RAM.
 void
 kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 {
-  if(mappages(kpgtbl, va, sz, pa, perm) != 0)
-    panic("kvmmap");
+  uint64 n;
+
+  while(sz > 0){
+    if((va % MEGAPGSIZE) == 0 && (pa % MEGAPGSIZE) == 0 && sz >= MEGAPGSIZE){
+      n = MEGAPGROUNDDOWN(sz);
+      if(mapmegapages(kpgtbl, va, n, pa, perm) != 0)
+        panic("kvmmap");
+    } else {
+      // ordinary pages up to the next megapage boundary.
+      n = MEGAPGROUNDDOWN(va + MEGAPGSIZE) - va;
+      if(n > sz)
+        n = sz;
+      if(mappages(kpgtbl, va, n, pa, perm) != 0)
+        panic("kvmmap");
+    }
+    va += n;
+    pa += n;
+    sz -= n;
+  }
 }
 
 // Create PTEs for virtual addresses starting at va that refer to
@@ -164,33 +279,104 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   return 0;
 }
 
+// Like mappages(), but create level-1 leaf PTEs, each of
+// which maps a 2-megabyte megapage. va, size, and pa must
+// be megapage-aligned. Returns 0 on success, -1 if walk()
+// couldn't allocate a needed page-table page.
+int
+mapmegapages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
+{
+  uint64 a, last;
+  pte_t *pte;
+
+  if(size == 0)
+    panic("mapmegapages: size");
+  if((va % MEGAPGSIZE) != 0 || (size % MEGAPGSIZE) != 0 || (pa % MEGAPGSIZE) != 0)
+    panic("mapmegapages: not aligned");
+
+  a = va;
+  last = va + size - MEGAPGSIZE;
+  for(;;){
+    if((pte = walklevel(pagetable, a, 1, 1, 0)) == 0)
+      return -1;
+    if(*pte & PTE_V)
+      panic("mapmegapages: remap");
+    *pte = PA2PTE(pa) | perm | PTE_V;
+    if(a == last)
+      break;
+    a += MEGAPGSIZE;
+    pa += MEGAPGSIZE;
+  }
+  return 0;
+}
+
 // Remove npages of mappings starting from va. va must be
 // page-aligned. The mappings must exist.
+// A megapage must be unmapped all at once; use uvmsplit()
+// first to unmap only part of one.
 // Optionally free the physical memory.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
+  uint64 a, pgsz;
   pte_t *pte;
+  int level;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0)
+  for(a = va; a < va + npages*PGSIZE; a += pgsz){
+    if((pte = walklevel(pagetable, a, 0, 0, &level)) == 0)
       panic("uvmunmap: walk");
     if((*pte & PTE_V) == 0)
       panic("uvmunmap: not mapped");
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
+    pgsz = PXSIZE(level);
+    if((a % pgsz) != 0 || a + pgsz > va + npages*PGSIZE)
+      panic("uvmunmap: partial megapage");
     if(do_free){
       uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
+      if(level == 0)
+        kfree((void*)pa);
+      else
+        kfree_mega((void*)pa);
     }
     *pte = 0;
   }
 }
 
+// If va lies inside, but not at the start of, a megapage
+// mapping, split the megapage into 512 ordinary PTEs in a
+// new level-0 page-table page, so that the pages on either
+// side of va can be unmapped or changed separately. The
+// physical pages are thereafter freed one at a time.
+// Returns 0 on success, -1 if kalloc() fails.
+int
+uvmsplit(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  pagetable_t pt;
+  uint64 pa;
+  int level;
+
+  if(va >= MAXVA || (va % MEGAPGSIZE) == 0)
+    return 0;
+  pte = walklevel(pagetable, va, 0, 0, &level);
+  if(pte == 0 || (*pte & PTE_V) == 0 || level == 0)
+    return 0;
+  if(level != 1)
+    panic("uvmsplit: level");
+
+  if((pt = (pagetable_t)kalloc()) == 0)
+    return -1;
+  pa = PTE2PA(*pte);
+  for(int i = 0; i < 512; i++)
+    pt[i] = PA2PTE(pa + i*PGSIZE) | PTE_FLAGS(*pte);
+  *pte = PA2PTE(pt) | PTE_V;
+  return 0;
+}
+
 // create an empty user page table.
 // returns 0 if out of memory.
 pagetable_t
@@ -222,25 +408,41 @@ uvmfirst(pagetable_t pagetable, uchar *src, uint sz)
 
 // Allocate PTEs and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Uses a megapage for each aligned 2 megabytes that lies entirely
+// inside the new memory, if kalloc_mega() has one to spare.
 uint64
 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 {
   char *mem;
-  uint64 a;
+  uint64 a, pgsz;
+  int r;
 
   if(newsz < oldsz)
     return oldsz;
 
   oldsz = PGROUNDUP(oldsz);
-  for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+  for(a = oldsz; a < newsz; a += pgsz){
+    pgsz = PGSIZE;
+    mem = 0;
+    if((a % MEGAPGSIZE) == 0 && a + MEGAPGSIZE <= PGROUNDUP(newsz) &&
+       (mem = kalloc_mega()) != 0)
+      pgsz = MEGAPGSIZE;
+    if(mem == 0)
+      mem = kalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
-    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
-      kfree(mem);
+    memset(mem, 0, pgsz);
+    if(pgsz == MEGAPGSIZE)
+      r = mapmegapages(pagetable, a, pgsz, (uint64)mem, PTE_R|PTE_U|xperm);
+    else
+      r = mappages(pagetable, a, pgsz, (uint64)mem, PTE_R|PTE_U|xperm);
+    if(r != 0){
+      if(pgsz == MEGAPGSIZE)
+        kfree_mega(mem);
+      else
+        kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
@@ -251,7 +453,8 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
-// process size.  Returns the new process size.
+// process size.  A megapage that straddles newsz must already have
+// been split with uvmsplit().  Returns the new process size.
 uint64
 uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 {
@@ -302,21 +505,45 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 // physical memory.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
+// a megapage in the parent is copied to a megapage in the
+// child if one is available, otherwise to ordinary pages.
+// shared memory pages (PTE_S) are mapped, not copied.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
   pte_t *pte;
-  uint64 pa, i;
+  uint64 pa, i, pgsz;
   uint flags;
   char *mem;
+  int level;
 
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
+  for(i = 0; i < sz; i += pgsz){
+    if((pte = walklevel(old, i, 0, 0, &level)) == 0)
       panic("uvmcopy: pte should exist");
     if((*pte & PTE_V) == 0)
       panic("uvmcopy: page not present");
-    pa = PTE2PA(*pte);
+    pa = PTE2PA(*pte) + (i & (PXSIZE(level) - 1));
     flags = PTE_FLAGS(*pte);
+    pgsz = PGSIZE;
+    if(flags & PTE_S){
+      // shared memory: the child maps the same page.
+      if(kdup((void*)pa) < 0)
+        goto err;
+      if(mappages(new, i, PGSIZE, pa, flags) != 0){
+        kfree((void*)pa);
+        goto err;
+      }
+      continue;
+    }
+    if(level == 1 && (i % MEGAPGSIZE) == 0 && (mem = kalloc_mega()) != 0){
+      memmove(mem, (char*)pa, MEGAPGSIZE);
+      if(mapmegapages(new, i, MEGAPGSIZE, (uint64)mem, flags) != 0){
+        kfree_mega(mem);
+        goto err;
+      }
+      pgsz = MEGAPGSIZE;
+      continue;
+    }
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
@@ -339,11 +566,82 @@ uvmclear(pagetable_t pagetable, uint64 va)
 {
   pte_t *pte;
   
+  // only this page may lose PTE_U, so it must not be
+  // part of a megapage.
+  if(uvmsplit(pagetable, PGROUNDDOWN(va)) != 0 ||
+     uvmsplit(pagetable, PGROUNDDOWN(va) + PGSIZE) != 0)
+    panic("uvmclear: split");
   pte = walk(pagetable, va, 0);
   if(pte == 0)
     panic("uvmclear");
   *pte &= ~PTE_U;
+#ifdef KVMUSER
+  // copyuser() runs with SSTATUS_SUM, which lets the kernel
+  // use non-PTE_U pages too. W without R is a reserved
+  // encoding, so any access to the guard page faults.
+  *pte = (*pte & ~(PTE_R|PTE_X)) | PTE_W;
+#endif
+}
+
+// A one-entry software TLB for copyout(), copyin(), and
+// copyinstr(): the leaf page-table page (or megapage PTE)
+// that mapped the last page they touched, so that copying
+// a range spanning many pages walks from the root only
+// once per 2 megabytes.
+struct walkcache {
+  uint64 start;   // first virtual address covered
+  uint64 end;     // one past the last; start == end if empty
+  pte_t *pte;     // level-0 page-table page, or megapage PTE
+  int level;      // level of the PTEs that pte points to
+};
+
+// Like walkaddr(), but consult and refill wc.
+static uint64
+walkaddrcache(pagetable_t pagetable, uint64 va, struct walkcache *wc)
+{
+  pte_t *pte;
+  int level;
+
+  if(va < wc->start || va >= wc->end){
+    if(va >= MAXVA)
+      return 0;
+    pte = walklevel(pagetable, va, 0, 1, &level);
+    if(pte == 0 || (*pte & PTE_V) == 0 || level != 1)
+      return 0;
+    if(PTE_LEAF(*pte)){
+      wc->pte = pte;
+      wc->level = 1;
+    } else {
+      wc->pte = (pte_t*)PTE2PA(*pte);
+      wc->level = 0;
+    }
+    wc->start = MEGAPGROUNDDOWN(va);
+    wc->end = wc->start + MEGAPGSIZE;
+  }
+
+  pte = wc->level == 0 ? &wc->pte[PX(0, va)] : wc->pte;
+  if((*pte & PTE_V) == 0)
+    return 0;
+  if((*pte & PTE_U) == 0)
+    return 0;
+  return PTE2PA(*pte) + (PGROUNDDOWN(va) & (PXSIZE(wc->level) - 1));
+}
+
+#ifdef KVMUSER
+// If pagetable belongs to the current process, return the
+// top of its user memory, which the process's kernel page
+// table (in use on this CPU) also maps, so that copyuser()
+// can reach it directly. Otherwise return 0.
+static uint64
+kvmusertop(pagetable_t pagetable)
+{
+  struct proc *p = myproc();
+
+  if(p != 0 && p->pagetable == pagetable)
+    return PGROUNDUP(p->sz);
+  return 0;
 }
+#endif
 
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
@@ -352,10 +650,22 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  struct walkcache wc = { 0 };
+
+#ifdef KVMUSER
+  uint64 top;
+  if((top = kvmusertop(pagetable)) != 0){
+    if(len == 0)
+      return 0;
+    if(dstva + len < dstva || dstva + len > top)
+      return -1;
+    return copyuser((void*)dstva, src, len);
+  }
+#endif
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = walkaddrcache(pagetable, va0, &wc);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (dstva - va0);
@@ -377,10 +687,22 @@ int
 copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
   uint64 n, va0, pa0;
+  struct walkcache wc = { 0 };
+
+#ifdef KVMUSER
+  uint64 top;
+  if((top = kvmusertop(pagetable)) != 0){
+    if(len == 0)
+      return 0;
+    if(srcva + len < srcva || srcva + len > top)
+      return -1;
+    return copyuser(dst, (void*)srcva, len);
+  }
+#endif
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = walkaddrcache(pagetable, va0, &wc);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -403,11 +725,24 @@ int
 copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
   uint64 n, va0, pa0;
+  struct walkcache wc = { 0 };
   int got_null = 0;
 
+#ifdef KVMUSER
+  uint64 top;
+  if((top = kvmusertop(pagetable)) != 0){
+    if(srcva >= top)
+      return -1;
+    n = top - srcva;
+    if(n > max)
+      n = max;
+    return copyuserstr(dst, (char*)srcva, n);
+  }
+#endif
+
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = walkaddrcache(pagetable, va0, &wc);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
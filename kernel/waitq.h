@@ -0,0 +1,14 @@
+// A queue of processes in poll() waiting for an object,
+// such as a pipe, to change. The object calls wakeq()
+// whenever it might have become ready.
+struct waitq {
+  struct spinlock lock;
+  struct pollent *head;
+};
+
+// One poll()ing process's place on one waitq.
+struct pollent {
+  struct proc *p;
+  struct waitq *q;     // queue this entry is on, or 0
+  struct pollent *next;
+};
@@ -0,0 +1,49 @@
+// Helpers for the benchmarks that spread work over the CPUs.
+// Link with programs that use them.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+#define NREC 1024
+
+static struct lockstat recs[NREC];
+
+// the number of CPUs that have taken a lock.
+int
+ncpu(void)
+{
+  int i, n, tot;
+
+  if((n = lockstat(recs, NREC)) < 0)
+    return 1;
+  tot = 0;
+  for(i = 0; i < n && i < NCPU; i++)
+    if(recs[i].nacquire > 0)
+      tot++;
+  return tot;
+}
+
+// run f(n) in nproc processes at once; return elapsed ticks.
+int
+runprocs(void (*f)(int), int n, int nproc)
+{
+  int i, t0;
+
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "runprocs: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      f(n);
+      exit(0);
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  return uptime() - t0;
+}
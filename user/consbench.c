@@ -0,0 +1,47 @@
+// Measure console write() throughput, writing the same
+// text once a line at a time and once a byte at a time.
+// usage: consbench [lines]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define LINESZ 64
+
+char line[LINESZ];
+
+int
+main(int argc, char *argv[])
+{
+  int n, i, j, t0, t1, t2;
+
+  n = 200;
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  for(i = 0; i < LINESZ-1; i++)
+    line[i] = 'a' + i % 26;
+  line[LINESZ-1] = '\n';
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(write(1, line, LINESZ) != LINESZ){
+      fprintf(2, "consbench: write failed\n");
+      exit(1);
+    }
+  }
+  t1 = uptime();
+  for(i = 0; i < n; i++){
+    for(j = 0; j < LINESZ; j++){
+      if(write(1, line+j, 1) != 1){
+        fprintf(2, "consbench: write failed\n");
+        exit(1);
+      }
+    }
+  }
+  t2 = uptime();
+
+  printf("consbench: %d bytes a line at a time in %d ticks\n", n*LINESZ, t1 - t0);
+  printf("consbench: %d bytes a byte at a time in %d ticks\n", n*LINESZ, t2 - t1);
+  exit(0);
+}
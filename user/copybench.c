@@ -0,0 +1,82 @@
+// Measure large read() and write() system calls, whose
+// cost is mostly copyout() and copyin() of user memory.
+// usage: copybench [iterations]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "user/user.h"
+
+// small enough that the file stays in the buffer cache.
+#define FILESZ (16*BSIZE)
+#define PIPESZ (64*1024)
+
+char buf[PIPESZ];
+
+int
+main(int argc, char *argv[])
+{
+  int n, i, fd, t0, t1, pid, cc, total;
+  int p[2];
+
+  n = 2000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  memset(buf, 'x', sizeof(buf));
+  fd = open("copybench.tmp", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, buf, FILESZ) != FILESZ){
+    fprintf(2, "copybench: cannot create copybench.tmp\n");
+    exit(1);
+  }
+  close(fd);
+
+  // file -> user: readi() copyout()s each cached block.
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    fd = open("copybench.tmp", O_RDONLY);
+    if(fd < 0 || read(fd, buf, FILESZ) != FILESZ){
+      fprintf(2, "copybench: read failed\n");
+      exit(1);
+    }
+    close(fd);
+  }
+  t1 = uptime();
+  printf("copybench: read %d x %d bytes in %d ticks\n", n, FILESZ, t1 - t0);
+  unlink("copybench.tmp");
+
+  // user -> pipe -> user: copyin() and copyout() of big buffers.
+  if(pipe(p) < 0){
+    fprintf(2, "copybench: pipe failed\n");
+    exit(1);
+  }
+  n /= 10;
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "copybench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p[1]);
+    while(read(p[0], buf, sizeof(buf)) > 0)
+      ;
+    exit(0);
+  }
+  close(p[0]);
+  t0 = uptime();
+  total = 0;
+  for(i = 0; i < n; i++){
+    if((cc = write(p[1], buf, sizeof(buf))) != sizeof(buf)){
+      fprintf(2, "copybench: write failed\n");
+      exit(1);
+    }
+    total += cc;
+  }
+  close(p[1]);
+  wait(0);
+  t1 = uptime();
+  printf("copybench: piped %d bytes in %d ticks\n", total, t1 - t0);
+
+  exit(0);
+}
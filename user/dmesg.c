@@ -0,0 +1,20 @@
+// print the kernel log.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+char buf[4096];
+
+int
+main(int argc, char *argv[])
+{
+  int n;
+
+  if((n = dmesg(buf, sizeof(buf))) < 0){
+    fprintf(2, "dmesg: failed\n");
+    exit(1);
+  }
+  write(1, buf, n);
+  exit(0);
+}
@@ -11,6 +11,7 @@ int main(int argc, char *argv[])
     }
     char *scope = argv[1];
     char *target = argv[2];
+    setvbuf(1, _IOFBF);
     find(scope, target);
     exit(0);
 }
@@ -22,7 +22,7 @@ grep(char *pattern, int fd)
       *q = 0;
       if(match(pattern, p)){
         *q = '\n';
-        write(1, p, q+1 - p);
+        fwrite(1, p, q+1 - p);
       }
       p = q+1;
     }
@@ -44,6 +44,7 @@ main(int argc, char *argv[])
     exit(1);
   }
   pattern = argv[1];
+  setvbuf(1, _IOFBF);
 
   if(argc <= 2){
     grep(pattern, 0);
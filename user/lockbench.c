@@ -0,0 +1,109 @@
+// Contend for the kmem and bcache locks from one process per
+// CPU, and report how long it took and how much the CPUs
+// spun on those locks.
+// usage: lockbench [iterations [nproc]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+#define NREC 1024
+
+struct lockstat recs[NREC];
+char buf[BSIZE];
+
+// total spins on locks named name.
+static uint64
+spins(char *name)
+{
+  int i, n;
+  uint64 tot;
+
+  if((n = lockstat(recs, NREC)) < 0){
+    fprintf(2, "lockbench: lockstat failed\n");
+    exit(1);
+  }
+  tot = 0;
+  for(i = 0; i < n; i++){
+    if(i >= NCPU && strcmp(recs[i].name, name) == 0)
+      tot += recs[i].nspin;
+  }
+  return tot;
+}
+
+// kalloc() and kfree() a page each time around.
+static void
+kmemloop(int n)
+{
+  char *p;
+
+  for(int i = 0; i < n; i++){
+    if((p = sbrk(4096)) == (char*)-1){
+      fprintf(2, "lockbench: sbrk failed\n");
+      exit(1);
+    }
+    p[0] = 1;
+    sbrk(-4096);
+  }
+}
+
+// bget() and brelse() a cached block each time around.
+static void
+bcacheloop(int n)
+{
+  int fd;
+
+  if((fd = open("lockbench.tmp", O_RDONLY)) < 0){
+    fprintf(2, "lockbench: cannot open lockbench.tmp\n");
+    exit(1);
+  }
+  for(int i = 0; i < n; i++){
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+      close(fd);
+      fd = open("lockbench.tmp", O_RDONLY);
+      if(fd < 0 || read(fd, buf, sizeof(buf)) != sizeof(buf)){
+        fprintf(2, "lockbench: read failed\n");
+        exit(1);
+      }
+    }
+  }
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, nproc, fd, i, t;
+  uint64 s0;
+
+  n = 20000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  nproc = ncpu();
+  if(argc > 2)
+    nproc = atoi(argv[2]);
+
+  fd = open("lockbench.tmp", O_CREATE|O_WRONLY);
+  if(fd < 0){
+    fprintf(2, "lockbench: cannot create lockbench.tmp\n");
+    exit(1);
+  }
+  for(i = 0; i < 8; i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+
+  printf("lockbench: %d processes, %d iterations each\n", nproc, n);
+  s0 = spins("kmem");
+  t = runprocs(kmemloop, n, nproc);
+  printf("kmem:   %d ticks, %l spins\n", t, spins("kmem") - s0);
+  s0 = spins("bcache");
+  t = runprocs(bcacheloop, n, nproc);
+  printf("bcache: %d ticks, %l spins\n", t, spins("bcache") - s0);
+
+  unlink("lockbench.tmp");
+  exit(0);
+}
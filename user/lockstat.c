@@ -0,0 +1,73 @@
+// print per-CPU lock totals, then the most contended kernel
+// locks, with same-named locks (like all the "proc" locks)
+// added together.
+// usage: lockstat [n]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+#define NREC     1024
+#define TIMEBASE 10000000  // time CSR ticks per second in qemu
+
+struct lockstat recs[NREC];
+int count[NREC];   // locks folded into recs[i]
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n, nlock, top;
+  struct lockstat t;
+
+  top = 10;
+  if(argc > 1)
+    top = atoi(argv[1]);
+
+  if((n = lockstat(recs, NREC)) < 0){
+    fprintf(2, "lockstat: failed\n");
+    exit(1);
+  }
+
+  printf("cpu   acquires spins\n");
+  for(i = 0; i < NCPU && i < n; i++)
+    if(recs[i].nacquire > 0)
+      printf("%s  %l %l\n", recs[i].name, recs[i].nacquire, recs[i].nspin);
+
+  // fold locks with the same name into the first of them.
+  nlock = 0;
+  for(i = NCPU; i < n; i++){
+    for(j = NCPU; j < NCPU + nlock; j++)
+      if(strcmp(recs[j].name, recs[i].name) == 0)
+        break;
+    if(j == NCPU + nlock){
+      recs[j] = recs[i];
+      count[j] = 1;
+      nlock++;
+    } else {
+      recs[j].nacquire += recs[i].nacquire;
+      recs[j].nspin += recs[i].nspin;
+      recs[j].hold += recs[i].hold;
+      count[j]++;
+    }
+  }
+
+  // sort by spins, most first.
+  for(i = NCPU + 1; i < NCPU + nlock; i++){
+    for(j = i; j > NCPU && recs[j-1].nspin < recs[j].nspin; j--){
+      t = recs[j];
+      recs[j] = recs[j-1];
+      recs[j-1] = t;
+      n = count[j];
+      count[j] = count[j-1];
+      count[j-1] = n;
+    }
+  }
+
+  printf("\nlock (instances) acquires spins hold-ms\n");
+  for(i = NCPU; i < NCPU + nlock && i < NCPU + top; i++)
+    printf("%s (%d) %l %l %l\n", recs[i].name, count[i],
+           recs[i].nacquire, recs[i].nspin, recs[i].hold / (TIMEBASE/1000));
+  exit(0);
+}
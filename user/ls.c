@@ -76,6 +76,7 @@ main(int argc, char *argv[])
 {
   int i;
 
+  setvbuf(1, _IOFBF);
   if(argc < 2){
     ls(".");
     exit(0);
@@ -0,0 +1,72 @@
+// Time malloc() and free() with many live blocks, which is
+// where a single first-fit free list gets slow.
+// usage: mallocbench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NLIVE 4000
+
+char *live[NLIVE];
+static uint seed = 1;
+
+static uint
+rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds, r, i, j, t0, t1;
+
+  rounds = 20;
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+
+  // fill the heap with small blocks of mixed sizes, then
+  // repeatedly free and reallocate random ones.
+  t0 = uptime();
+  for(i = 0; i < NLIVE; i++){
+    if((live[i] = malloc(8 + rand() % 500)) == 0){
+      fprintf(2, "mallocbench: out of memory\n");
+      exit(1);
+    }
+  }
+  for(r = 0; r < rounds; r++){
+    for(j = 0; j < NLIVE; j++){
+      i = rand() % NLIVE;
+      free(live[i]);
+      if((live[i] = malloc(8 + rand() % 500)) == 0){
+        fprintf(2, "mallocbench: out of memory\n");
+        exit(1);
+      }
+      live[i][0] = r;
+    }
+  }
+  for(i = 0; i < NLIVE; i++)
+    free(live[i]);
+  t1 = uptime();
+  printf("mallocbench: %d small malloc/free pairs with %d live in %d ticks\n",
+         NLIVE + rounds*NLIVE, NLIVE, t1 - t0);
+
+  // large blocks.
+  t0 = uptime();
+  for(r = 0; r < rounds; r++){
+    for(i = 0; i < 64; i++){
+      if((live[i] = malloc(8192 + rand() % 65536)) == 0){
+        fprintf(2, "mallocbench: out of memory\n");
+        exit(1);
+      }
+    }
+    for(i = 0; i < 64; i++)
+      free(live[i]);
+  }
+  t1 = uptime();
+  printf("mallocbench: %d large malloc/free pairs in %d ticks\n", rounds*64, t1 - t0);
+
+  exit(0);
+}
@@ -0,0 +1,60 @@
+// Look up the same path, and read the clock, from one process
+// per CPU at once: the path walk takes itable.lock for every
+// component, and uptime() reads ticks.
+// usage: namebench [iterations [nproc]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+static void
+statloop(int n)
+{
+  struct stat st;
+
+  for(int i = 0; i < n; i++){
+    if(stat("nbdir/a/b/file", &st) < 0){
+      fprintf(2, "namebench: stat failed\n");
+      exit(1);
+    }
+  }
+}
+
+static void
+uptimeloop(int n)
+{
+  for(int i = 0; i < n; i++)
+    uptime();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, nproc, fd;
+
+  n = 5000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  nproc = ncpu();
+  if(argc > 2)
+    nproc = atoi(argv[2]);
+
+  if(mkdir("nbdir") < 0 || mkdir("nbdir/a") < 0 || mkdir("nbdir/a/b") < 0 ||
+     (fd = open("nbdir/a/b/file", O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "namebench: cannot create nbdir/a/b/file\n");
+    exit(1);
+  }
+  close(fd);
+
+  printf("namebench: %d processes, %d iterations each\n", nproc, n);
+  printf("stat:   %d ticks\n", runprocs(statloop, n, nproc));
+  printf("uptime: %d ticks\n", runprocs(uptimeloop, 20*n, nproc));
+
+  unlink("nbdir/a/b/file");
+  unlink("nbdir/a/b");
+  unlink("nbdir/a");
+  unlink("nbdir");
+  exit(0);
+}
@@ -0,0 +1,55 @@
+// Open and close files from one process per CPU at once,
+// which allocates and frees struct files and descriptors,
+// then see how many descriptors one process can hold.
+// usage: openbench [iterations [nproc]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+static void
+openloop(int n)
+{
+  int fd;
+
+  for(int i = 0; i < n; i++){
+    // open() does a path walk; dup() doesn't.
+    if((fd = open("openbench.tmp", O_RDONLY)) < 0){
+      fprintf(2, "openbench: open failed\n");
+      exit(1);
+    }
+    close(dup(fd));
+    close(fd);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, nproc, fd, nfd;
+
+  n = 5000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  nproc = ncpu();
+  if(argc > 2)
+    nproc = atoi(argv[2]);
+
+  if((fd = open("openbench.tmp", O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "openbench: cannot create openbench.tmp\n");
+    exit(1);
+  }
+  close(fd);
+
+  printf("openbench: %d processes, %d iterations each\n", nproc, n);
+  printf("open/dup/close: %d ticks\n", runprocs(openloop, n, nproc));
+
+  for(nfd = 0; dup(0) >= 0; nfd++)
+    ;
+  printf("descriptors: %d more fit after 0, 1 and 2\n", nfd);
+
+  unlink("openbench.tmp");
+  exit(0);
+}
@@ -0,0 +1,114 @@
+// Read disjoint regions of one file from one process per CPU
+// at once, first with lseek() and read() on a descriptor each,
+// then with pread() on a single shared descriptor.
+// usage: preadbench [rounds [nproc]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define FILESIZE (64*1024)
+#define CHUNK 1024
+
+char buf[CHUNK];
+
+// read region [lo, hi) rounds times, checking each chunk.
+static void
+reader(int fd, int lo, int hi, int rounds, int positional)
+{
+  int i, off;
+
+  for(i = 0; i < rounds; i++){
+    for(off = lo; off < hi; off += CHUNK){
+      if(positional){
+        if(pread(fd, buf, CHUNK, off) != CHUNK)
+          goto bad;
+      } else {
+        if(lseek(fd, off, SEEK_SET) != off || read(fd, buf, CHUNK) != CHUNK)
+          goto bad;
+      }
+      if(buf[0] != (char)(off / CHUNK))
+        goto bad;
+    }
+  }
+  exit(0);
+
+bad:
+  fprintf(2, "preadbench: bad read at %d\n", off);
+  exit(1);
+}
+
+static int
+run(int nproc, int rounds, int positional)
+{
+  int i, fd, region, t0, status, ok;
+
+  region = FILESIZE / nproc / CHUNK * CHUNK;
+  fd = open("preadbench.tmp", O_RDONLY);
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "preadbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      if(!positional){
+        close(fd);
+        fd = open("preadbench.tmp", O_RDONLY);
+      }
+      reader(fd, i*region, (i+1)*region, rounds, positional);
+    }
+  }
+  ok = 1;
+  for(i = 0; i < nproc; i++){
+    wait(&status);
+    if(status != 0)
+      ok = 0;
+  }
+  close(fd);
+  if(!ok)
+    exit(1);
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds, nproc, fd, off;
+
+  rounds = 50;
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  nproc = ncpu();
+  if(argc > 2)
+    nproc = atoi(argv[2]);
+  if(nproc < 1 || nproc > FILESIZE / CHUNK){
+    fprintf(2, "preadbench: bad nproc %d\n", nproc);
+    exit(1);
+  }
+
+  // each chunk starts with its own number.
+  if((fd = open("preadbench.tmp", O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    fprintf(2, "preadbench: cannot create preadbench.tmp\n");
+    exit(1);
+  }
+  for(off = 0; off < FILESIZE; off += CHUNK){
+    buf[0] = off / CHUNK;
+    if(write(fd, buf, CHUNK) != CHUNK){
+      fprintf(2, "preadbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  printf("preadbench: %d processes, %d rounds of %d bytes each\n",
+         nproc, rounds, FILESIZE / nproc / CHUNK * CHUNK);
+  printf("lseek+read: %d ticks\n", run(nproc, rounds, 0));
+  printf("pread:      %d ticks\n", run(nproc, rounds, 1));
+
+  unlink("preadbench.tmp");
+  exit(0);
+}
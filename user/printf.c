@@ -6,14 +6,107 @@
 
 static char digits[] = "0123456789ABCDEF";
 
+// Output buffering. printf() and fprintf() collect each call's
+// output and write() it at once. setvbuf() lets a program that
+// prints a lot keep output to fd 1 or 2 buffered across calls,
+// until a newline (_IOLBF) or until the buffer fills (_IOFBF).
+// Buffered output is flushed by fflush() and by exit().
+#define NSTREAM   3
+#define STREAMSZ  512
+#define CALLSZ    128   // small, since user stacks are one page
+
+struct stream {
+  int fd;
+  int mode;
+  int n;
+  int size;
+  char *buf;
+};
+
+static struct stream streams[NSTREAM];
+static char streambuf[NSTREAM][STREAMSZ];
+
 static void
-putc(int fd, char c)
+flush(struct stream *s)
 {
-  write(fd, &c, 1);
+  if(s->n > 0)
+    write(s->fd, s->buf, s->n);
+  s->n = 0;
 }
 
 static void
-printint(int fd, int xx, int base, int sgn)
+flushall(void)
+{
+  int fd;
+
+  for(fd = 0; fd < NSTREAM; fd++)
+    flush(&streams[fd]);
+}
+
+static void
+putc(struct stream *s, char c)
+{
+  s->buf[s->n++] = c;
+  if(s->n == s->size || (s->mode == _IOLBF && c == '\n'))
+    flush(s);
+}
+
+// The stream that output to fd goes through, or 0 if fd
+// isn't buffered across calls.
+static struct stream*
+stream(int fd)
+{
+  if(fd >= 0 && fd < NSTREAM && streams[fd].mode != _IONBF)
+    return &streams[fd];
+  return 0;
+}
+
+void
+setvbuf(int fd, int mode)
+{
+  struct stream *s;
+
+  if(fd < 0 || fd >= NSTREAM)
+    return;
+  s = &streams[fd];
+  flush(s);
+  s->fd = fd;
+  s->mode = mode;
+  s->size = STREAMSZ;
+  s->buf = streambuf[fd];
+  exithook = flushall;
+}
+
+// Flush fd's buffered output, or all of it if fd is -1.
+void
+fflush(int fd)
+{
+  struct stream *s;
+
+  if(fd == -1)
+    flushall();
+  else if((s = stream(fd)) != 0)
+    flush(s);
+}
+
+// Like write(), but goes through fd's buffer if it has one.
+int
+fwrite(int fd, const void *buf, int n)
+{
+  struct stream *s;
+  const char *p;
+  int i;
+
+  if((s = stream(fd)) == 0)
+    return write(fd, buf, n);
+  p = buf;
+  for(i = 0; i < n; i++)
+    putc(s, p[i]);
+  return n;
+}
+
+static void
+printint(struct stream *s, int xx, int base, int sgn)
 {
   char buf[16];
   int i, neg;
@@ -35,25 +128,37 @@ printint(int fd, int xx, int base, int sgn)
     buf[i++] = '-';
 
   while(--i >= 0)
-    putc(fd, buf[i]);
+    putc(s, buf[i]);
 }
 
 static void
-printptr(int fd, uint64 x) {
+printptr(struct stream *s, uint64 x) {
   int i;
-  putc(fd, '0');
-  putc(fd, 'x');
+  putc(s, '0');
+  putc(s, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    putc(fd, digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(s, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 // Print to the given fd. Only understands %d, %x, %p, %s.
 void
 vprintf(int fd, const char *fmt, va_list ap)
 {
-  char *s;
+  struct stream call, *s;
+  char callbuf[CALLSZ];
+  char *str;
   int c, i, state;
 
+  if((s = stream(fd)) == 0){
+    // unbuffered: still make just one write() for this call.
+    s = &call;
+    s->fd = fd;
+    s->mode = _IONBF;
+    s->n = 0;
+    s->size = sizeof(callbuf);
+    s->buf = callbuf;
+  }
+
   state = 0;
   for(i = 0; fmt[i]; i++){
     c = fmt[i] & 0xff;
@@ -61,37 +166,40 @@ vprintf(int fd, const char *fmt, va_list ap)
       if(c == '%'){
         state = '%';
       } else {
-        putc(fd, c);
+        putc(s, c);
       }
     } else if(state == '%'){
       if(c == 'd'){
-        printint(fd, va_arg(ap, int), 10, 1);
+        printint(s, va_arg(ap, int), 10, 1);
       } else if(c == 'l') {
-        printint(fd, va_arg(ap, uint64), 10, 0);
+        printint(s, va_arg(ap, uint64), 10, 0);
       } else if(c == 'x') {
-        printint(fd, va_arg(ap, int), 16, 0);
+        printint(s, va_arg(ap, int), 16, 0);
       } else if(c == 'p') {
-        printptr(fd, va_arg(ap, uint64));
+        printptr(s, va_arg(ap, uint64));
       } else if(c == 's'){
-        s = va_arg(ap, char*);
-        if(s == 0)
-          s = "(null)";
-        while(*s != 0){
-          putc(fd, *s);
-          s++;
+        str = va_arg(ap, char*);
+        if(str == 0)
+          str = "(null)";
+        while(*str != 0){
+          putc(s, *str);
+          str++;
         }
       } else if(c == 'c'){
-        putc(fd, va_arg(ap, uint));
+        putc(s, va_arg(ap, uint));
       } else if(c == '%'){
-        putc(fd, c);
+        putc(s, c);
       } else {
         // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c);
+        putc(s, '%');
+        putc(s, c);
       }
       state = 0;
     }
   }
+
+  if(s == &call)
+    flush(s);
 }
 
 void
@@ -0,0 +1,128 @@
+// Compare small read()s and write()s made one system call at a
+// time with the same operations batched through ioring_enter().
+// usage: ringbench [operations]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/ioring.h"
+#include "user/user.h"
+
+#define IOSZ  16
+#define BATCH 32
+#define FILESZ 4096
+
+char buf[BATCH][IOSZ];
+
+// read n IOSZ-byte pieces of the file, restarting at the
+// beginning as needed, with one system call per read.
+static int
+plainread(int n)
+{
+  int fd, i, t0;
+
+  t0 = uptime();
+  fd = open("ringbench.tmp", O_RDONLY);
+  for(i = 0; i < n; i++){
+    if(read(fd, buf[0], IOSZ) != IOSZ){
+      close(fd);
+      fd = open("ringbench.tmp", O_RDONLY);
+      i--;
+    }
+  }
+  close(fd);
+  return uptime() - t0;
+}
+
+// the same, BATCH reads per ioring_enter().
+static int
+ringread(struct ioring *r, int n)
+{
+  struct iocqe cqe;
+  int fd, i, j, t0, short_;
+
+  t0 = uptime();
+  fd = open("ringbench.tmp", O_RDONLY);
+  for(i = 0; i < n; i += BATCH){
+    for(j = 0; j < BATCH; j++)
+      ioring_prep(r, IORING_OP_READ, fd, buf[j], IOSZ, j);
+    if(ioring_submit(r) != BATCH){
+      fprintf(2, "ringbench: submit failed\n");
+      exit(1);
+    }
+    short_ = 0;
+    while(ioring_reap(r, &cqe))
+      if(cqe.res != IOSZ)
+        short_ = 1;
+    if(short_){
+      // hit the end of the file; start again.
+      close(fd);
+      fd = open("ringbench.tmp", O_RDONLY);
+    }
+  }
+  close(fd);
+  return uptime() - t0;
+}
+
+// write n IOSZ-byte pieces to a pipe that a child drains.
+static int
+pipewrite(struct ioring *r, int n)
+{
+  struct iocqe cqe;
+  int p[2], i, j, t0;
+
+  if(pipe(p) < 0){
+    fprintf(2, "ringbench: pipe failed\n");
+    exit(1);
+  }
+  if(fork() == 0){
+    close(p[1]);
+    while(read(p[0], buf[0], IOSZ) > 0)
+      ;
+    exit(0);
+  }
+  close(p[0]);
+  t0 = uptime();
+  for(i = 0; i < n; i += BATCH){
+    if(r == 0){
+      for(j = 0; j < BATCH; j++)
+        write(p[1], buf[j], IOSZ);
+      continue;
+    }
+    for(j = 0; j < BATCH; j++)
+      ioring_prep(r, IORING_OP_WRITE, p[1], buf[j], IOSZ, j);
+    ioring_submit(r);
+    while(ioring_reap(r, &cqe))
+      ;
+  }
+  close(p[1]);
+  wait(0);
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct ioring *r;
+  int n, fd, i;
+
+  n = 20000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  if((r = ioring_setup()) == 0){
+    fprintf(2, "ringbench: cannot allocate ring\n");
+    exit(1);
+  }
+  fd = open("ringbench.tmp", O_CREATE|O_WRONLY);
+  for(i = 0; i < FILESZ; i += IOSZ)
+    write(fd, buf[0], IOSZ);
+  close(fd);
+
+  printf("ringbench: %d operations of %d bytes\n", n, IOSZ);
+  printf("file read:  %d ticks plain, %d ticks ring\n", plainread(n), ringread(r, n));
+  printf("pipe write: %d ticks plain, %d ticks ring\n", pipewrite(0, n), pipewrite(r, n));
+
+  unlink("ringbench.tmp");
+  exit(0);
+}
@@ -0,0 +1,148 @@
+// Pass messages from a parent to a child through a ring
+// buffer in a shmcreate() segment, and then through a pipe,
+// to compare the two. Each side sleeps in futex() only when
+// the ring is empty or full.
+// usage: shmbench [megabytes]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/futex.h"
+#include "user/user.h"
+
+#define MSGSIZE 1024
+#define NSLOT 32
+
+struct ring {
+  int head;   // messages produced
+  int tail;   // messages consumed
+  char slot[NSLOT][MSGSIZE];
+};
+
+char buf[MSGSIZE];
+
+static void
+produce(struct ring *r, int n)
+{
+  int i, t;
+
+  for(i = 0; i < n; i++){
+    while(i - (t = r->tail) == NSLOT)
+      futex(&r->tail, FUTEX_WAIT, t);
+    buf[0] = i;
+    memmove(r->slot[i % NSLOT], buf, MSGSIZE);
+    __sync_synchronize();
+    r->head = i + 1;
+    __sync_synchronize();
+    // the consumer may be waiting only if the ring was empty.
+    if(i == r->tail)
+      futex(&r->head, FUTEX_WAKE, 1);
+  }
+}
+
+static int
+consume(struct ring *r, int n)
+{
+  int i, h;
+
+  for(i = 0; i < n; i++){
+    while((h = r->head) == i)
+      futex(&r->head, FUTEX_WAIT, h);
+    __sync_synchronize();
+    memmove(buf, r->slot[i % NSLOT], MSGSIZE);
+    if(buf[0] != (char)i)
+      return -1;
+    __sync_synchronize();
+    r->tail = i + 1;
+    __sync_synchronize();
+    // the producer may be waiting only if the ring was full.
+    if(r->head - i == NSLOT)
+      futex(&r->tail, FUTEX_WAKE, 1);
+  }
+  return 0;
+}
+
+static int
+viashm(int n)
+{
+  struct ring *r;
+  int fd, pid, xstatus;
+
+  if((fd = shmcreate(sizeof(struct ring))) < 0 ||
+     (r = (struct ring*)shmmap(fd)) == (struct ring*)-1){
+    fprintf(2, "shmbench: shmcreate failed\n");
+    exit(1);
+  }
+  close(fd);
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "shmbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0)
+    exit(consume(r, n) < 0);
+  produce(r, n);
+  wait(&xstatus);
+  return xstatus;
+}
+
+static int
+viapipe(int n)
+{
+  int fds[2], pid, xstatus, i, m, k;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "shmbench: pipe failed\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "shmbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[1]);
+    for(i = 0; i < n; i++){
+      for(m = 0; m < MSGSIZE; m += k)
+        if((k = read(fds[0], buf + m, MSGSIZE - m)) <= 0)
+          exit(1);
+      if(buf[0] != (char)i)
+        exit(1);
+    }
+    exit(0);
+  }
+  close(fds[0]);
+  for(i = 0; i < n; i++){
+    buf[0] = i;
+    if(write(fds[1], buf, MSGSIZE) != MSGSIZE)
+      break;
+  }
+  close(fds[1]);
+  wait(&xstatus);
+  return xstatus;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb, n, t0;
+
+  mb = 8;
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  n = mb * (1024*1024 / MSGSIZE);
+
+  printf("shmbench: %d MB in %d-byte messages\n", mb, MSGSIZE);
+  t0 = uptime();
+  if(viashm(n) != 0){
+    fprintf(2, "shmbench: shm transfer failed\n");
+    exit(1);
+  }
+  printf("shm: %d ticks\n", uptime() - t0);
+  t0 = uptime();
+  if(viapipe(n) != 0){
+    fprintf(2, "shmbench: pipe transfer failed\n");
+    exit(1);
+  }
+  printf("pipe: %d ticks\n", uptime() - t0);
+  exit(0);
+}
@@ -0,0 +1,58 @@
+// Measure how long nanosleep() and sleep() really take,
+// against the clock_gettime() clock.
+// usage: sleepbench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/time.h"
+#include "user/user.h"
+
+static uint64
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(&ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+  static int us[] = { 100, 1000, 10000, 100000 };
+  struct timespec ts;
+  uint64 t0, tot;
+  int i, j, rounds;
+
+  rounds = 10;
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(rounds < 1){
+    fprintf(2, "sleepbench: bad rounds\n");
+    exit(1);
+  }
+
+  for(i = 0; i < sizeof(us)/sizeof(us[0]); i++){
+    ts.tv_sec = 0;
+    ts.tv_nsec = us[i] * 1000;
+    tot = 0;
+    for(j = 0; j < rounds; j++){
+      t0 = now();
+      if(nanosleep(&ts) < 0){
+        fprintf(2, "sleepbench: nanosleep failed\n");
+        exit(1);
+      }
+      tot += now() - t0;
+    }
+    printf("nanosleep %d us: %d us\n", us[i], (int)(tot / rounds / 1000));
+  }
+
+  tot = 0;
+  for(j = 0; j < rounds; j++){
+    t0 = now();
+    sleep(1);
+    tot += now() - t0;
+  }
+  printf("sleep 1 tick: %d us\n", (int)(tot / rounds / 1000));
+  exit(0);
+}
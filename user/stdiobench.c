@@ -0,0 +1,58 @@
+// Measure printf() of short lines in each output buffering
+// mode, against the old one-write()-per-character printf().
+// Output goes to a scratch file so that the console's speed
+// doesn't hide the cost of the write() system calls.
+// usage: stdiobench [lines]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define LINE "stdiobench: a line of output\n"
+
+static int
+run(int n, int mode, int bytewise)
+{
+  int i, t0, fd;
+
+  close(1);
+  fd = open("stdiobench.tmp", O_CREATE|O_TRUNC|O_WRONLY);
+  if(fd != 1){
+    fprintf(2, "stdiobench: cannot create stdiobench.tmp\n");
+    exit(1);
+  }
+  setvbuf(1, mode);
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(bytewise){
+      // one write() per character, as printf() used to.
+      for(char *p = LINE; *p; p++)
+        write(1, p, 1);
+    } else
+      printf(LINE);
+  }
+  fflush(1);
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, len;
+
+  n = 2000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  len = strlen(LINE);
+
+  fprintf(2, "stdiobench: %d lines of %d bytes\n", n, len);
+  fprintf(2, "  per character:  %d ticks, %d writes/line\n", run(n, _IONBF, 1), len);
+  fprintf(2, "  unbuffered:     %d ticks, 1 write/line\n", run(n, _IONBF, 0));
+  fprintf(2, "  line buffered:  %d ticks, 1 write/line\n", run(n, _IOLBF, 0));
+  fprintf(2, "  fully buffered: %d ticks, 1 write/%d lines\n", run(n, _IOFBF, 0), 512 / len);
+
+  close(1);
+  unlink("stdiobench.tmp");
+  exit(0);
+}
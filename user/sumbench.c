@@ -0,0 +1,87 @@
+// Sum a shared array with 1, 2, 4, ... threads, each summing
+// its own slice, to see how clone()d threads scale across
+// CPUs. The partial sums meet under a mutex.
+// usage: sumbench [rounds [maxthreads]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define N (1024*1024)
+
+struct slice {
+  int lo, hi;
+} slices[NCPU];
+
+int *a;
+int rounds;
+struct mutex m;
+uint64 total;
+
+static void
+sum(void *arg)
+{
+  struct slice *s = arg;
+  uint64 t = 0;
+  int r, i;
+
+  for(r = 0; r < rounds; r++)
+    for(i = s->lo; i < s->hi; i++)
+      t += a[i];
+  mutex_lock(&m);
+  total += t;
+  mutex_unlock(&m);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, max, t0;
+  uint64 want;
+
+  rounds = 20;
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  max = ncpu();
+  if(argc > 2)
+    max = atoi(argv[2]);
+  if(max < 1 || max > NCPU){
+    fprintf(2, "sumbench: bad maxthreads %d\n", max);
+    exit(1);
+  }
+
+  if((a = malloc(N * sizeof(int))) == 0){
+    fprintf(2, "sumbench: out of memory\n");
+    exit(1);
+  }
+  want = 0;
+  for(i = 0; i < N; i++){
+    a[i] = i & 0xff;
+    want += a[i];
+  }
+  want *= rounds;
+  mutex_init(&m);
+
+  printf("sumbench: %d rounds over %d ints\n", rounds, N);
+  for(n = 1; n <= max; n *= 2){
+    total = 0;
+    t0 = uptime();
+    for(i = 0; i < n; i++){
+      slices[i].lo = (uint64)N * i / n;
+      slices[i].hi = (uint64)N * (i+1) / n;
+      if(thread_create(sum, &slices[i]) < 0){
+        fprintf(2, "sumbench: thread_create failed\n");
+        exit(1);
+      }
+    }
+    for(i = 0; i < n; i++)
+      thread_join();
+    printf("%d threads: %d ticks\n", n, uptime() - t0);
+    if(total != want){
+      fprintf(2, "sumbench: wrong sum\n");
+      exit(1);
+    }
+  }
+  exit(0);
+}
@@ -0,0 +1,62 @@
+// Measure the cost of a round trip into the kernel and
+// of a switch between two processes, in clock ticks.
+// usage: syscallbench [iterations]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int n, i, t0, t1, pid;
+  int p1[2], p2[2];
+  char c;
+
+  n = 100000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  // null system call: trap in, trap out.
+  t0 = uptime();
+  for(i = 0; i < n; i++)
+    getpid();
+  t1 = uptime();
+  printf("syscallbench: %d getpid() calls in %d ticks\n", n, t1 - t0);
+
+  // ping-pong a byte between two processes, which costs
+  // two context switches and four traps per round trip.
+  if(pipe(p1) < 0 || pipe(p2) < 0){
+    fprintf(2, "syscallbench: pipe failed\n");
+    exit(1);
+  }
+  n /= 10;
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "syscallbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p1[1]);
+    close(p2[0]);
+    while(read(p1[0], &c, 1) == 1)
+      write(p2[1], &c, 1);
+    exit(0);
+  }
+  close(p1[0]);
+  close(p2[1]);
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    write(p1[1], "x", 1);
+    if(read(p2[0], &c, 1) != 1){
+      fprintf(2, "syscallbench: read failed\n");
+      exit(1);
+    }
+  }
+  t1 = uptime();
+  close(p1[1]);
+  wait(0);
+  printf("syscallbench: %d pipe round trips in %d ticks\n", n, t1 - t0);
+
+  exit(0);
+}
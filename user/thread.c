@@ -0,0 +1,119 @@
+// Threads, made with clone(), that share the process's memory
+// and open files, and mutexes that sleep in futex() only when
+// contended. Link with programs that use them.
+
+#include "kernel/types.h"
+#include "kernel/futex.h"
+#include "user/user.h"
+
+#define NTHREAD   64
+#define STACKSIZE (4*4096)
+
+struct thread {
+  int tid;            // 0 if the slot is free
+  void (*fn)(void*);
+  void *arg;
+  char *stack;
+};
+
+static struct thread threads[NTHREAD];
+static struct mutex tlock;  // protects threads[]
+
+// where each thread starts, on its own stack.
+static void
+start(void *a)
+{
+  struct thread *t = a;
+
+  t->fn(t->arg);
+  // don't flush stdio buffers the other threads may be using.
+  _exit(0);
+}
+
+// Start fn(arg) in a new thread. Returns its thread id,
+// or -1 on failure.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  struct thread *t;
+  int tid;
+
+  mutex_lock(&tlock);
+  for(t = threads; t < &threads[NTHREAD]; t++)
+    if(t->tid == 0 && t->stack == 0)
+      break;
+  if(t == &threads[NTHREAD] || (t->stack = malloc(STACKSIZE)) == 0){
+    mutex_unlock(&tlock);
+    return -1;
+  }
+  t->fn = fn;
+  t->arg = arg;
+  t->tid = -1;  // claimed
+  // malloc() memory is 16-byte aligned, as sp must be.
+  if((tid = clone(start, t, t->stack + STACKSIZE)) < 0){
+    free(t->stack);
+    t->stack = 0;
+    t->tid = 0;
+  } else {
+    t->tid = tid;
+  }
+  mutex_unlock(&tlock);
+  return tid;
+}
+
+// Wait for a thread this thread created to exit, and free
+// its stack. Returns its id, or -1 if there are none.
+// Like wait(), may instead return a fork()ed child.
+int
+thread_join(void)
+{
+  struct thread *t;
+  int tid;
+
+  if((tid = wait(0)) < 0)
+    return -1;
+  mutex_lock(&tlock);
+  for(t = threads; t < &threads[NTHREAD]; t++){
+    if(t->tid == tid){
+      free(t->stack);
+      t->stack = 0;
+      t->tid = 0;
+      break;
+    }
+  }
+  mutex_unlock(&tlock);
+  return tid;
+}
+
+// A mutex's state is 0 if unlocked, 1 if locked, and 2 if
+// locked with other threads perhaps waiting, after Drepper,
+// "Futexes Are Tricky".
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->state, 2);
+  while(c != 0){
+    futex(&m->state, FUTEX_WAIT, 2);
+    c = __sync_lock_test_and_set(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    __sync_lock_release(&m->state);
+    futex(&m->state, FUTEX_WAKE, 1);
+  }
+}
@@ -1,6 +1,10 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/ioring.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/usyscall.h"
 #include "user/user.h"
 
 //
@@ -14,6 +18,33 @@ _main()
   exit(0);
 }
 
+void (*exithook)(void);
+
+// run exithook (printf.c's flush of buffered output) before
+// the exit system call.
+int
+exit(int status)
+{
+  if(exithook)
+    exithook();
+  _exit(status);
+}
+
+// getpid() and uptime() read the pages that the kernel
+// maps at USYSCALL and UTIME, rather than trapping to
+// _getpid() and _uptime().
+int
+getpid(void)
+{
+  return ((volatile struct usyscall*)USYSCALL)->pid;
+}
+
+int
+uptime(void)
+{
+  return ((volatile struct utime*)UTIME)->ticks;
+}
+
 char*
 strcpy(char *s, const char *t)
 {
@@ -145,3 +176,62 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// A small helper library for the ioring_enter() rings, after
+// liburing: ioring_prep() queues operations, ioring_submit()
+// hands them all to the kernel in one system call, and
+// ioring_reap() collects their results.
+
+// allocate a zeroed ring in a page of its own.
+struct ioring*
+ioring_setup(void)
+{
+  char *p;
+  uint64 pad;
+
+  p = sbrk(0);
+  pad = (4096 - (uint64)p % 4096) % 4096;
+  if(sbrk(pad + 4096) == (char*)-1)
+    return 0;
+  p += pad;
+  memset(p, 0, sizeof(struct ioring));
+  return (struct ioring*)p;
+}
+
+// queue an operation; data comes back with its result.
+// returns -1 if the submission queue is full.
+int
+ioring_prep(struct ioring *r, int op, int fd, void *addr, int len, uint64 data)
+{
+  struct iosqe *sqe;
+
+  if(r->sqtail - r->sqhead >= IORING_NSQ)
+    return -1;
+  sqe = &r->sq[r->sqtail % IORING_NSQ];
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->addr = (uint64)addr;
+  sqe->len = len;
+  sqe->data = data;
+  r->sqtail++;
+  return 0;
+}
+
+// submit everything queued. returns how many the kernel took,
+// which is fewer if the completion queue filled up.
+int
+ioring_submit(struct ioring *r)
+{
+  return ioring_enter(r, r->sqtail - r->sqhead);
+}
+
+// take the oldest result. returns 0 if there are none.
+int
+ioring_reap(struct ioring *r, struct iocqe *cqe)
+{
+  if(r->cqhead == r->cqtail)
+    return 0;
+  *cqe = r->cq[r->cqhead % IORING_NCQ];
+  r->cqhead++;
+  return 1;
+}
@@ -3,30 +3,109 @@
 #include "user/user.h"
 #include "kernel/param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator.
+//
+// Small requests come from segregated free lists, one per
+// power-of-two size class from 32 to 4096 bytes (including
+// the header), so that malloc() and free() of a small block
+// are just a pop or a push. An empty list is refilled by
+// carving fresh memory from sbrk() into blocks of its size;
+// blocks never move between classes.
+//
+// Larger requests get memory straight from sbrk(), and are
+// freed onto an address-ordered first-fit list that coalesces
+// neighbors, after Kernighan and Ritchie, The C Programming
+// Language, 2nd ed.  Section 8.7. Once the free block at the
+// top of the heap grows past TRIMSIZE, free() gives its pages
+// back to the kernel with a negative sbrk().
+//
+// A spin lock keeps clone()d threads out of each other's way.
 
 typedef long Align;
 
 union header {
   struct {
-    union header *ptr;
-    uint size;
+    union header *ptr;  // next block on its free list
+    uint size;          // in units of sizeof(Header)
+    uint cls;           // size class, or LARGE
   } s;
   Align x;
 };
 
 typedef union header Header;
 
+#define NCLASS    8                           // 32, 64, ..., 4096 bytes
+#define MINBLOCK  32                          // bytes in class 0 blocks
+#define MAXSMALL  (MINBLOCK << (NCLASS-1))    // bytes in the largest class
+#define LARGE     NCLASS                      // cls of a large block
+#define TRIMSIZE  (64*1024)                   // free bytes at the top worth returning
+
+static Header *freelist[NCLASS];
+
 static Header base;
-static Header *freep;
+static Header *freep;   // the large-block list
 
-void
-free(void *ap)
+// Grow the heap by n bytes, keeping blocks Header-aligned
+// even if the program has called sbrk() itself.
+// Returns 0 if out of memory.
+static char*
+heapgrow(uint64 n)
 {
-  Header *bp, *p;
+  char *p;
+  uint pad;
+
+  pad = (sizeof(Header) - (uint64)sbrk(0) % sizeof(Header)) % sizeof(Header);
+  if(n + pad > 0x7fffffff)   // sbrk() takes an int
+    return 0;
+  p = sbrk(n + pad);
+  if(p == (char*)-1)
+    return 0;
+  return p + pad;
+}
+
+// The size class for a request of nbytes, or LARGE.
+static int
+sizeclass(uint nbytes)
+{
+  int c;
+
+  if(nbytes > MAXSMALL - sizeof(Header))
+    return LARGE;
+  for(c = 0; (MINBLOCK << c) < nbytes + sizeof(Header); c++)
+    ;
+  return c;
+}
+
+// Refill the empty free list of class c with a page's worth
+// of blocks (at least four).
+static int
+refill(int c)
+{
+  uint bsize, n;
+  char *p, *q;
+  Header *hp;
+
+  bsize = MINBLOCK << c;
+  n = bsize < 1024 ? 4096 : 4*bsize;
+  if((p = heapgrow(n)) == 0)
+    return -1;
+  for(q = p; q + bsize <= p + n; q += bsize){
+    hp = (Header*)q;
+    hp->s.size = bsize / sizeof(Header);
+    hp->s.cls = c;
+    hp->s.ptr = freelist[c];
+    freelist[c] = hp;
+  }
+  return 0;
+}
+
+// Put large block bp on the free list, merging it with its
+// neighbors. Returns the free block that now contains bp.
+static Header*
+largefree(Header *bp)
+{
+  Header *p;
 
-  bp = (Header*)ap - 1;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
       break;
@@ -38,30 +117,54 @@ free(void *ap)
   if(p + p->s.size == bp){
     p->s.size += bp->s.size;
     p->s.ptr = bp->s.ptr;
+    bp = p;
   } else
     p->s.ptr = bp;
   freep = p;
+  return bp;
+}
+
+// If free block bp is at the top of the heap and big enough,
+// shrink the heap to return its pages to the kernel. bp keeps
+// at least its header, so it stays on the list and merges with
+// whatever morecore() gets next.
+static void
+trim(Header *bp)
+{
+  uint64 n;
+
+  if((char*)(bp + bp->s.size) != sbrk(0))
+    return;
+  n = (uint64)(bp->s.size - 1) * sizeof(Header);
+  if(n < TRIMSIZE)
+    return;
+  n &= ~4095L;
+  if(sbrk(-n) == (char*)-1)
+    return;
+  bp->s.size -= n / sizeof(Header);
 }
 
+// Get a large block of at least nu units from sbrk(),
+// rounded up to whole pages, and put it on the large list.
 static Header*
 morecore(uint nu)
 {
   char *p;
   Header *hp;
+  uint64 n;
 
-  if(nu < 4096)
-    nu = 4096;
-  p = sbrk(nu * sizeof(Header));
-  if(p == (char*)-1)
+  n = ((uint64)nu * sizeof(Header) + 4095) & ~4095L;
+  if((p = heapgrow(n)) == 0)
     return 0;
   hp = (Header*)p;
-  hp->s.size = nu;
-  free((void*)(hp + 1));
+  hp->s.size = n / sizeof(Header);
+  hp->s.cls = LARGE;
+  largefree(hp);
   return freep;
 }
 
-void*
-malloc(uint nbytes)
+static void*
+largealloc(uint nbytes)
 {
   Header *p, *prevp;
   uint nunits;
@@ -70,6 +173,7 @@ malloc(uint nbytes)
   if((prevp = freep) == 0){
     base.s.ptr = freep = prevp = &base;
     base.s.size = 0;
+    base.s.cls = LARGE;
   }
   for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
     if(p->s.size >= nunits){
@@ -79,6 +183,7 @@ malloc(uint nbytes)
         p->s.size -= nunits;
         p += p->s.size;
         p->s.size = nunits;
+        p->s.cls = LARGE;
       }
       freep = prevp;
       return (void*)(p + 1);
@@ -88,3 +193,59 @@ malloc(uint nbytes)
         return 0;
   }
 }
+
+static int locked;
+
+static void
+lock(void)
+{
+  while(__sync_lock_test_and_set(&locked, 1) != 0)
+    ;
+}
+
+static void
+unlock(void)
+{
+  __sync_lock_release(&locked);
+}
+
+void
+free(void *ap)
+{
+  Header *bp;
+
+  if(ap == 0)
+    return;
+  bp = (Header*)ap - 1;
+  lock();
+  if(bp->s.cls == LARGE){
+    trim(largefree(bp));
+  } else {
+    bp->s.ptr = freelist[bp->s.cls];
+    freelist[bp->s.cls] = bp;
+  }
+  unlock();
+}
+
+void*
+malloc(uint nbytes)
+{
+  Header *p;
+  int c;
+
+  c = sizeclass(nbytes);
+  lock();
+  if(c == LARGE){
+    p = largealloc(nbytes);
+    unlock();
+    return p;
+  }
+  if(freelist[c] == 0 && refill(c) < 0){
+    unlock();
+    return 0;
+  }
+  p = freelist[c];
+  freelist[c] = p->s.ptr;
+  unlock();
+  return (void*)(p + 1);
+}
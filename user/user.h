@@ -1,8 +1,14 @@
 struct stat;
+struct lockstat;
+struct ioring;
+struct iocqe;
+struct iovec;
+struct pollfd;
+struct timespec;
 
 // system calls
 int fork(void);
-int exit(int) __attribute__((noreturn));
+int _exit(int) __attribute__((noreturn));
 int wait(int*);
 int pipe(int*);
 int write(int, const void*, int);
@@ -18,12 +24,33 @@ int link(const char*, const char*);
 int mkdir(const char*);
 int chdir(const char*);
 int dup(int);
-int getpid(void);
+int _getpid(void);
 char* sbrk(int);
 int sleep(int);
-int uptime(void);
+int _uptime(void);
+int dmesg(char*, int);
+int lockstat(struct lockstat*, int);
+int ioring_enter(struct ioring*, int);
+int readv(int, const struct iovec*, int);
+int writev(int, const struct iovec*, int);
+int pread(int, void*, int, int);
+int pwrite(int, const void*, int, int);
+int lseek(int, int, int);
+int splice(int, int, int);
+int poll(struct pollfd*, int, int);
+int fcntl(int, int, int);
+int clone(void (*)(void*), void*, void*);
+int futex(int*, int, int);
+int shmcreate(int);
+char* shmmap(int);
+int nanosleep(const struct timespec*);
+int clock_gettime(struct timespec*);
 
 // ulib.c
+int exit(int) __attribute__((noreturn));
+extern void (*exithook)(void);
+int getpid(void);
+int uptime(void);
 int stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
 void *memmove(void*, const void*, int);
@@ -39,3 +66,29 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+struct ioring* ioring_setup(void);
+int ioring_prep(struct ioring*, int, int, void*, int, uint64);
+int ioring_submit(struct ioring*);
+int ioring_reap(struct ioring*, struct iocqe*);
+
+// printf.c
+#define _IONBF 0  // unbuffered
+#define _IOLBF 1  // line buffered
+#define _IOFBF 2  // fully buffered
+void setvbuf(int, int);
+void fflush(int);
+int fwrite(int, const void*, int);
+
+// thread.c
+struct mutex {
+  int state;
+};
+int thread_create(void (*)(void*), void*);
+int thread_join(void);
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+
+// bench.c
+int ncpu(void);
+int runprocs(void (*)(int), int, int);
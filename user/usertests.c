@@ -4,6 +4,11 @@
 #include "user/user.h"
 #include "kernel/fs.h"
 #include "kernel/fcntl.h"
+#include "kernel/ioring.h"
+#include "kernel/uio.h"
+#include "kernel/poll.h"
+#include "kernel/futex.h"
+#include "kernel/time.h"
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
@@ -2554,7 +2559,857 @@ sbrk8000(char *s)
   *(top-1) = *(top-1) + 1;
 }
 
+// a big, megapage-aligned sbrk() is backed by megapages.
+// does fork() copy them, and does shrinking the break into
+// the middle of one split it without losing the memory below?
+void
+sbrkmega(char *s)
+{
+  char *a, *p;
+  uint64 top;
+  int pid, xstatus;
+
+  top = (uint64) sbrk(0);
+  if(top % MEGAPGSIZE)
+    sbrk(MEGAPGSIZE - (top % MEGAPGSIZE));
+  a = sbrk(2*MEGAPGSIZE);
+  if(a == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(p = a; p < a + 2*MEGAPGSIZE; p += PGSIZE)
+    *p = (p - a) / PGSIZE;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(p = a; p < a + 2*MEGAPGSIZE; p += PGSIZE){
+      if(*p != (char)((p - a) / PGSIZE)){
+        printf("%s: child saw wrong data at %p\n", s, p);
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+
+  // leave half of the first megapage.
+  if(sbrk(-(MEGAPGSIZE + MEGAPGSIZE/2)) == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk could not shrink\n", s);
+    exit(1);
+  }
+  if(sbrk(0) != a + MEGAPGSIZE/2){
+    printf("%s: wrong break after shrink\n", s);
+    exit(1);
+  }
+  for(p = a; p < a + MEGAPGSIZE/2; p += PGSIZE){
+    if(*p != (char)((p - a) / PGSIZE)){
+      printf("%s: lost data at %p after shrink\n", s, p);
+      exit(1);
+    }
+  }
+
+  // the freed half must come back zeroed.
+  sbrk(MEGAPGSIZE/2);
+  for(p = a + MEGAPGSIZE/2; p < a + MEGAPGSIZE; p += PGSIZE){
+    if(*p != 0){
+      printf("%s: re-grown memory not zeroed\n", s);
+      exit(1);
+    }
+  }
+}
+
+
+
+// does free() give a big block at the top of the heap back
+// to the kernel, so that the process shrinks?
+void
+malloctrim(char *s)
+{
+  enum { BIG = 1024*1024 };
+  char *top0, *a, *b;
+
+  top0 = sbrk(0);
+  a = malloc(BIG);
+  b = malloc(BIG);
+  if(a == 0 || b == 0){
+    printf("%s: malloc failed\n", s);
+    exit(1);
+  }
+  if(sbrk(0) < top0 + 2*BIG){
+    printf("%s: heap did not grow\n", s);
+    exit(1);
+  }
+  a[0] = b[BIG-1] = 1;
+
+  // a is not at the top, so freeing it can't shrink the heap.
+  free(a);
+  if(sbrk(0) < top0 + 2*BIG){
+    printf("%s: heap shrank below a live block\n", s);
+    exit(1);
+  }
+
+  // b merges with a, and both go back to the kernel.
+  free(b);
+  if(sbrk(0) >= top0 + 64*1024){
+    printf("%s: heap not trimmed, %d bytes over\n", s, (int)(sbrk(0) - top0));
+    exit(1);
+  }
+
+  // the heap can grow again.
+  a = malloc(BIG);
+  if(a == 0){
+    printf("%s: malloc after trim failed\n", s);
+    exit(1);
+  }
+  a[BIG-1] = 1;
+  free(a);
+}
+
+// dmesg() returns the kernel log, which holds at least the
+// boot messages, and checks the user buffer.
+void
+dmesgtest(char *s)
+{
+  static char buf[4096];
+  int n;
+
+  n = dmesg(buf, sizeof(buf)-1);
+  if(n <= 0 || n > sizeof(buf)-1){
+    printf("%s: dmesg returned %d\n", s, n);
+    exit(1);
+  }
+  if(dmesg(buf, 0) != 0){
+    printf("%s: dmesg of 0 bytes failed\n", s);
+    exit(1);
+  }
+  if(dmesg((char*)0xffffffffffffff00ULL, 16) != -1){
+    printf("%s: dmesg to a kernel address succeeded\n", s);
+    exit(1);
+  }
+}
+
+// a process can have more than the initial NOFILE descriptors
+// open, and a forked child inherits all of them.
+void
+manyfds(char *s)
+{
+  enum { N = 100 };
+  int fds[N], i, pid, xstatus;
+  char c;
+
+  for(i = 0; i < N; i++){
+    if((fds[i] = dup(1)) < 0){
+      printf("%s: dup #%d failed\n", s, i);
+      exit(1);
+    }
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(write(fds[N-1], "", 0) != 0)
+      exit(1);
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child lost a descriptor\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++)
+    close(fds[i]);
+  if(read(fds[N-1], &c, 1) != -1){
+    printf("%s: read from closed descriptor succeeded\n", s);
+    exit(1);
+  }
+}
+
+// open, write, read and close a file through ioring_enter().
+void
+ioringtest(char *s)
+{
+  struct ioring *r;
+  struct iocqe cqe;
+  char *name = "ioring.tmp";
+  char in[6];
+  int fd, i;
+
+  if((r = ioring_setup()) == 0){
+    printf("%s: ioring_setup failed\n", s);
+    exit(1);
+  }
+
+  ioring_prep(r, IORING_OP_OPEN, 0, name, O_CREATE|O_RDWR, 1);
+  if(ioring_submit(r) != 1 || ioring_reap(r, &cqe) != 1 || cqe.data != 1 || cqe.res < 0){
+    printf("%s: ring open failed\n", s);
+    exit(1);
+  }
+  fd = cqe.res;
+
+  ioring_prep(r, IORING_OP_WRITE, fd, "hello", 5, 2);
+  ioring_prep(r, IORING_OP_WRITE, fd, "world", 5, 3);
+  ioring_prep(r, IORING_OP_CLOSE, fd, 0, 0, 4);
+  ioring_prep(r, IORING_OP_READ, fd, in, 5, 5);  // fd is closed by now
+  if(ioring_submit(r) != 4){
+    printf("%s: submit failed\n", s);
+    exit(1);
+  }
+  for(i = 2; i <= 5; i++){
+    if(ioring_reap(r, &cqe) != 1 || cqe.data != i){
+      printf("%s: missing completion %d\n", s, i);
+      exit(1);
+    }
+    if(cqe.res != (i <= 3 ? 5 : i == 4 ? 0 : -1)){
+      printf("%s: completion %d returned %d\n", s, i, cqe.res);
+      exit(1);
+    }
+  }
+
+  fd = open(name, O_RDONLY);
+  if(fd < 0 || read(fd, in, 5) != 5 || memcmp(in, "hello", 5) != 0){
+    printf("%s: ring write didn't stick\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink(name);
+
+  if(ioring_enter((struct ioring*)((char*)r + 8), 1) != -1){
+    printf("%s: unaligned ring accepted\n", s);
+    exit(1);
+  }
+  // the kernel writes the ring, so read-only text won't do.
+  if(ioring_enter((struct ioring*)0, 1) != -1){
+    printf("%s: read-only ring accepted\n", s);
+    exit(1);
+  }
+}
+
+// gather a file out of several buffers with writev() and
+// scatter it back with readv(), on a file and on a pipe.
+void
+rwvtest(char *s)
+{
+  struct iovec iov[3];
+  char *name = "rwv.tmp";
+  char a[4], b[6], c[8];
+  int fd, fds[2];
+
+  iov[0].iov_base = "abc";
+  iov[0].iov_len = 3;
+  iov[1].iov_base = "";
+  iov[1].iov_len = 0;
+  iov[2].iov_base = "defghij";
+  iov[2].iov_len = 7;
+
+  fd = open(name, O_CREATE|O_RDWR);
+  if(fd < 0 || writev(fd, iov, 3) != 10){
+    printf("%s: writev failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  memset(c, 0, sizeof(c));
+  iov[0].iov_base = a;
+  iov[0].iov_len = 4;
+  iov[1].iov_base = b;
+  iov[1].iov_len = 2;
+  iov[2].iov_base = c;
+  iov[2].iov_len = sizeof(c);
+  fd = open(name, O_RDONLY);
+  if(fd < 0 || readv(fd, iov, 3) != 10){
+    printf("%s: readv failed\n", s);
+    exit(1);
+  }
+  if(memcmp(a, "abcd", 4) != 0 || memcmp(b, "ef", 2) != 0 || memcmp(c, "ghij", 5) != 0){
+    printf("%s: readv scattered wrong data\n", s);
+    exit(1);
+  }
+  close(fd);
+  // a bad buffer that gets nothing is an error, not a 0-byte read.
+  iov[0].iov_base = (char*)0xffffffffff;
+  fd = open(name, O_RDONLY);
+  if(fd < 0 || readv(fd, iov, 1) != -1){
+    printf("%s: readv into bad buffer succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink(name);
+
+  // a pipe readv() returns what has arrived rather than
+  // waiting to fill every buffer.
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  iov[0].iov_base = "xyz";
+  iov[0].iov_len = 3;
+  if(writev(fds[1], iov, 1) != 3){
+    printf("%s: pipe writev failed\n", s);
+    exit(1);
+  }
+  iov[0].iov_base = a;
+  iov[0].iov_len = 4;
+  if(readv(fds[0], iov, 3) != 3 || memcmp(a, "xyz", 3) != 0){
+    printf("%s: pipe readv failed\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  if(readv(0, iov, UIO_MAXIOV+1) != -1 || writev(1, (struct iovec*)0xffffffffff, 1) != -1){
+    printf("%s: bad iovec accepted\n", s);
+    exit(1);
+  }
+}
+
+// pread() and pwrite() at given offsets leave the file offset
+// alone; lseek() moves it within the file.
+void
+preadtest(char *s)
+{
+  char *name = "pread.tmp";
+  char in[8];
+  int fd;
+
+  fd = open(name, O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, "0123456789", 10) != 10){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  if(pwrite(fd, "ab", 2, 3) != 2 || pread(fd, in, 4, 2) != 4 || memcmp(in, "2ab5", 4) != 0){
+    printf("%s: pwrite/pread wrong\n", s);
+    exit(1);
+  }
+  // the offset is still at the end.
+  if(read(fd, in, 1) != 0 || pread(fd, in, 4, 8) != 2 || pread(fd, in, 4, 11) != 0){
+    printf("%s: pread moved the offset\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 4, SEEK_SET) != 4 || lseek(fd, 1, SEEK_CUR) != 5 ||
+     read(fd, in, 1) != 1 || in[0] != '5' || lseek(fd, -3, SEEK_END) != 7 ||
+     read(fd, in, 3) != 3 || memcmp(in, "789", 3) != 0){
+    printf("%s: lseek wrong\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 1, SEEK_END) != -1 || lseek(fd, -1, SEEK_SET) != -1 || lseek(fd, 0, 3) != -1){
+    printf("%s: bad lseek accepted\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink(name);
+
+  if(pread(0, in, 1, 0) != -1){
+    printf("%s: pread on the console succeeded\n", s);
+    exit(1);
+  }
+}
+
+// splice() a file to a file and through a pipe.
+void
+splicetest(char *s)
+{
+  char *src = "splice.src", *dst = "splice.dst";
+  char in[8];
+  int i, fd, fd1, fds[2], out[2];
+
+  fd = open(src, O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  // more than one page, so it takes more than one buffer.
+  for(i = 0; i < 1000; i++){
+    if(write(fd, "01234567", 8) != 8){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  fd = open(src, O_RDONLY);
+  fd1 = open(dst, O_CREATE|O_RDWR);
+  if(fd < 0 || fd1 < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  if(splice(fd, fd1, 8) != 8 || splice(fd, fd1, 100000) != 7992 || splice(fd, fd1, 8) != 0){
+    printf("%s: file to file splice wrong\n", s);
+    exit(1);
+  }
+  if(pread(fd1, in, 8, 7000) != 8 || memcmp(in, "01234567", 8) != 0){
+    printf("%s: spliced data wrong\n", s);
+    exit(1);
+  }
+  if(splice(fd, fd1, 0) != 0 || splice(fd1, fd, 1) != -1 || splice(fd, fd1, -1) != -1 || splice(fd1, -1, 1) != -1){
+    printf("%s: bad splice accepted\n", s);
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  lseek(fd, 8, SEEK_SET);
+  if(splice(fd, fds[1], 16) != 16 || splice(fds[0], fd1, 100) != 16){
+    printf("%s: pipe splice wrong\n", s);
+    exit(1);
+  }
+  if(pread(fd1, in, 8, 8008) != 8 || memcmp(in, "01234567", 8) != 0){
+    printf("%s: data from pipe wrong\n", s);
+    exit(1);
+  }
+
+  // an O_NONBLOCK out with room for 8 bytes takes only 8 from
+  // the in pipe, and then none; the rest stays in the pipe.
+  if(pipe(out) < 0 || fcntl(out[1], F_SETFL, O_NONBLOCK) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  while(write(out[1], "xxxxxxxx", 8) == 8)
+    ;
+  if(read(out[0], in, 8) != 8 || write(fds[1], "0123456789abcdef", 16) != 16){
+    printf("%s: pipe read/write failed\n", s);
+    exit(1);
+  }
+  if(splice(fds[0], out[1], 16) != 8 || splice(fds[0], out[1], 16) != -EAGAIN){
+    printf("%s: splice into full pipe wrong\n", s);
+    exit(1);
+  }
+  if(read(fds[0], in, 8) != 8 || memcmp(in, "89abcdef", 8) != 0){
+    printf("%s: splice lost data\n", s);
+    exit(1);
+  }
+  close(out[0]);
+  close(out[1]);
+  close(fds[0]);
+  close(fds[1]);
+  close(fd);
+  close(fd1);
+  unlink(src);
+  unlink(dst);
+}
+
+// one process serves many pipes with poll(), never blocking
+// in read(), until every writer has hung up.
+void
+polltest(char *s)
+{
+  enum { N = 8, MSGS = 20 };
+  struct pollfd fds[N+1];
+  int fd[2], i, j, pid, nopen, got[N], n;
+  char c;
+
+  for(i = 0; i < N; i++){
+    if(pipe(fd) < 0){
+      printf("%s: pipe failed\n", s);
+      exit(1);
+    }
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(fd[0]);
+      for(j = 0; j < MSGS; j++){
+        c = i;
+        if(write(fd[1], &c, 1) != 1)
+          exit(1);
+        if(j % 4 == i % 4)
+          sleep(1);
+      }
+      exit(0);
+    }
+    close(fd[1]);
+    fds[i].fd = fd[0];
+    fds[i].events = POLLIN;
+    got[i] = 0;
+  }
+  fds[N].fd = -1;  // skipped
+
+  for(nopen = N; nopen > 0; ){
+    n = poll(fds, N+1, -1);
+    if(n <= 0){
+      printf("%s: poll returned %d\n", s, n);
+      exit(1);
+    }
+    for(i = 0; i < N; i++){
+      if(fds[i].revents & POLLIN){
+        if(read(fds[i].fd, &c, 1) != 1 || c != i){
+          printf("%s: bad read from pipe %d\n", s, i);
+          exit(1);
+        }
+        got[i]++;
+      } else if(fds[i].revents & POLLHUP){
+        close(fds[i].fd);
+        fds[i].fd = -1;
+        nopen--;
+      }
+    }
+    if(fds[N].revents != 0){
+      printf("%s: revents set for a negative fd\n", s);
+      exit(1);
+    }
+  }
+  for(i = 0; i < N; i++){
+    wait(0);
+    if(got[i] != MSGS){
+      printf("%s: got %d of %d from pipe %d\n", s, got[i], MSGS, i);
+      exit(1);
+    }
+  }
+
+  // a timeout with nothing ready returns 0; a bad fd is POLLNVAL.
+  if(pipe(fd) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  fds[0].fd = fd[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = fd[1];
+  fds[1].events = POLLOUT;
+  if(poll(fds, 1, 2) != 0 || fds[0].revents != 0){
+    printf("%s: poll didn't time out\n", s);
+    exit(1);
+  }
+  if(poll(fds, 2, 0) != 1 || fds[1].revents != POLLOUT){
+    printf("%s: pipe not writable\n", s);
+    exit(1);
+  }
+  fds[0].fd = 100;
+  if(poll(fds, 1, 0) != 1 || fds[0].revents != POLLNVAL){
+    printf("%s: bad fd not reported\n", s);
+    exit(1);
+  }
+  close(fd[0]);
+  close(fd[1]);
+}
+
+// O_NONBLOCK pipe ends return -EAGAIN instead of waiting.
+char nbbuf[1024];
+
+void
+nonblocktest(char *s)
+{
+  int fds[2], n;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_SETFL, O_NONBLOCK) != 0 || fcntl(fds[1], F_SETFL, O_NONBLOCK) != 0 ||
+     fcntl(fds[0], F_GETFL, 0) != (O_RDONLY|O_NONBLOCK) || fcntl(fds[1], F_GETFL, 0) != (O_WRONLY|O_NONBLOCK)){
+    printf("%s: fcntl failed\n", s);
+    exit(1);
+  }
+  if(read(fds[0], nbbuf, 1) != -EAGAIN){
+    printf("%s: read from empty pipe didn't return -EAGAIN\n", s);
+    exit(1);
+  }
+
+  // fill the pipe: the write takes what fits.
+  n = write(fds[1], nbbuf, sizeof(nbbuf));
+  if(n <= 0 || n >= sizeof(nbbuf) || write(fds[1], nbbuf, 1) != -EAGAIN){
+    printf("%s: write to full pipe returned %d\n", s, n);
+    exit(1);
+  }
+  if(read(fds[0], nbbuf, sizeof(nbbuf)) != n || read(fds[0], nbbuf, 1) != -EAGAIN){
+    printf("%s: read back failed\n", s);
+    exit(1);
+  }
+
+  // with the writer gone, read() returns end-of-file, not -EAGAIN.
+  close(fds[1]);
+  if(read(fds[0], nbbuf, 1) != 0){
+    printf("%s: no end-of-file\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_SETFL, 0) != 0 || fcntl(fds[0], F_GETFL, 0) != O_RDONLY || fcntl(fds[0], 99, 0) != -1){
+    printf("%s: couldn't clear O_NONBLOCK\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+}
+
+// threads share memory, under a mutex, and open files.
+struct mutex clonemu;
+int clonecount;
+int clonefd;
+
+void
+cloneworker(void *arg)
+{
+  int i;
+
+  for(i = 0; i < 1000; i++){
+    mutex_lock(&clonemu);
+    clonecount++;
+    mutex_unlock(&clonemu);
+  }
+  if(arg)
+    close(clonefd);
+}
+
+void
+clonetest(char *s)
+{
+  enum { N = 4 };
+  int i, tid, fds[2];
+
+  mutex_init(&clonemu);
+  clonecount = 0;
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  clonefd = fds[1];
+  for(i = 0; i < N; i++){
+    if(thread_create(cloneworker, i == 0 ? &clonefd : 0) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for(i = 0; i < N; i++){
+    if((tid = thread_join()) < 0){
+      printf("%s: thread_join failed\n", s);
+      exit(1);
+    }
+  }
+  if(clonecount != N*1000){
+    printf("%s: count %d, not %d\n", s, clonecount, N*1000);
+    exit(1);
+  }
+  // a thread closed the write end, so this is end-of-file.
+  if(read(fds[0], &i, 1) != 0){
+    printf("%s: thread's close() not shared\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+
+  // futex() doesn't wait if the word has already changed.
+  i = 1;
+  if(futex(&i, FUTEX_WAIT, 0) != -1 || futex(&i, FUTEX_WAKE, 1) != 0){
+    printf("%s: futex wrong\n", s);
+    exit(1);
+  }
+}
+
+// one thread close()s a pipe's read end while another is
+// blocked reading it; the reader keeps the pipe alive.
+int closerfds[2];
+char closerbuf[2];
+int closerret;
+
+void
+closereader(void *arg)
+{
+  closerret = read(closerfds[0], closerbuf, sizeof(closerbuf));
+}
+
+void
+closeracetest(char *s)
+{
+  if(pipe(closerfds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  closerret = -2;
+  if(thread_create(closereader, 0) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  sleep(2);
+  if(close(closerfds[0]) != 0 || close(closerfds[0]) != -1){
+    printf("%s: close wrong\n", s);
+    exit(1);
+  }
+  if(write(closerfds[1], "x", 1) != 1){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  if(thread_join() < 0){
+    printf("%s: thread_join failed\n", s);
+    exit(1);
+  }
+  if(closerret != 1 || closerbuf[0] != 'x'){
+    printf("%s: blocked read returned %d\n", s, closerret);
+    exit(1);
+  }
+  close(closerfds[1]);
+}
+
+void
+shmtest(char *s)
+{
+  enum { SZ = 2*4096 + 1 };
+  int fd, i, pid, xstatus;
+  char *a, *b;
+
+  if(shmcreate(0) != -1 || shmcreate(64*1024*1024) != -1){
+    printf("%s: bad sizes accepted\n", s);
+    exit(1);
+  }
+  if((fd = shmcreate(SZ)) < 0){
+    printf("%s: shmcreate failed\n", s);
+    exit(1);
+  }
+  if((a = shmmap(fd)) == (char*)-1){
+    printf("%s: shmmap failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++){
+    if(a[i] != 0){
+      printf("%s: not zeroed\n", s);
+      exit(1);
+    }
+  }
+  if(read(fd, &i, 1) != -1 || write(fd, &i, 1) != -1){
+    printf("%s: read/write on a segment\n", s);
+    exit(1);
+  }
+  a[0] = 'p';
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    // the child's inherited mapping, and a new one,
+    // are both the parent's memory.
+    a[SZ-1] = 'c';
+    if((b = shmmap(fd)) == (char*)-1 || b == a || b[0] != 'p')
+      exit(1);
+    b[1] = 'x';
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0 || a[1] != 'x' || a[SZ-1] != 'c'){
+    printf("%s: memory not shared with child\n", s);
+    exit(1);
+  }
+
+  // the mapping outlives the descriptor.
+  close(fd);
+  a[2] = 'y';
+  if(sbrk(a - sbrk(0)) == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+
+  // segments go away when unmapped and closed.
+  for(i = 0; i < 200; i++){
+    if((fd = shmcreate(64*1024)) < 0 || (a = shmmap(fd)) == (char*)-1){
+      printf("%s: shmcreate %d failed\n", s, i);
+      exit(1);
+    }
+    close(fd);
+    a[0] = 1;
+    sbrk(a - sbrk(0));
+  }
+}
+
+void
+usyscalltest(char *s)
+{
+  int pid, xstatus, t;
+
+  if(getpid() != _getpid()){
+    printf("%s: getpid() %d, _getpid() %d\n", s, getpid(), _getpid());
+    exit(1);
+  }
+  t = _uptime();
+  if(uptime() < t - 1 || uptime() > t + 1){
+    printf("%s: uptime() %d, _uptime() %d\n", s, uptime(), t);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(getpid() != _getpid())
+      exit(1);
+    // the page is read-only.
+    *(volatile int*)USYSCALL = 0;
+    exit(1);
+  }
+  wait(&xstatus);
+  if(xstatus != -1){
+    printf("%s: child %d\n", s, xstatus);
+    exit(1);
+  }
+}
+
+static uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  if(clock_gettime(&ts) < 0 || ts.tv_nsec >= 1000000000){
+    printf("clock_gettime failed\n");
+    exit(1);
+  }
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+nanosleeptest(char *s)
+{
+  struct timespec ts;
+  uint64 t0, t1;
+
+  t0 = nsnow();
+  t1 = nsnow();
+  if(t1 < t0){
+    printf("%s: clock went backwards\n", s);
+    exit(1);
+  }
 
+  ts.tv_sec = 0;
+  ts.tv_nsec = 1000000000;
+  if(nanosleep(&ts) != -1 || nanosleep((struct timespec*)0xffffffffffL) != -1){
+    printf("%s: bad timespec accepted\n", s);
+    exit(1);
+  }
+  // so long a sleep would wrap the deadline around to the past.
+  ts.tv_sec = ~0ULL / 2;
+  ts.tv_nsec = 0;
+  if(nanosleep(&ts) != -1){
+    printf("%s: overflowing timespec accepted\n", s);
+    exit(1);
+  }
+  ts.tv_sec = 0;
+
+  // 20 milliseconds, well under a clock tick.
+  ts.tv_nsec = 20000000;
+  t0 = nsnow();
+  if(nanosleep(&ts) != 0){
+    printf("%s: nanosleep failed\n", s);
+    exit(1);
+  }
+  t1 = nsnow();
+  if(t1 - t0 < 20000000){
+    printf("%s: woke after %d ns\n", s, (int)(t1 - t0));
+    exit(1);
+  }
+
+  ts.tv_nsec = 0;
+  if(nanosleep(&ts) != 0){
+    printf("%s: zero nanosleep failed\n", s);
+    exit(1);
+  }
+}
 
 // regression test. test whether exec() leaks memory if one of the
 // arguments is invalid. the test passes if the kernel doesn't panic.
@@ -2634,6 +3489,21 @@ struct test {
   {sbrkbugs, "sbrkbugs" },
   {sbrklast, "sbrklast"},
   {sbrk8000, "sbrk8000"},
+  {sbrkmega, "sbrkmega"},
+  {malloctrim, "malloctrim"},
+  {dmesgtest, "dmesgtest"},
+  {manyfds, "manyfds"},
+  {ioringtest, "ioringtest"},
+  {rwvtest, "rwvtest"},
+  {preadtest, "preadtest"},
+  {splicetest, "splicetest"},
+  {polltest, "polltest"},
+  {nonblocktest, "nonblocktest"},
+  {clonetest, "clonetest"},
+  {closeracetest, "closeracetest"},
+  {shmtest, "shmtest"},
+  {usyscalltest, "usyscalltest"},
+  {nanosleeptest, "nanosleeptest"},
   {badarg, "badarg" },
 
   { 0, 0},
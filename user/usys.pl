@@ -6,17 +6,20 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry("exit", "_exit") names the stub _exit, leaving
+# exit() to ulib.c. likewise getpid() and uptime().
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $sym = shift || $name;
+    print ".global $sym\n";
+    print "${sym}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
 entry("fork");
-entry("exit");
+entry("exit", "_exit");
 entry("wait");
 entry("pipe");
 entry("read");
@@ -32,7 +35,24 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+entry("getpid", "_getpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+entry("uptime", "_uptime");
+entry("dmesg");
+entry("lockstat");
+entry("ioring_enter");
+entry("readv");
+entry("writev");
+entry("pread");
+entry("pwrite");
+entry("lseek");
+entry("splice");
+entry("poll");
+entry("fcntl");
+entry("clone");
+entry("futex");
+entry("shmcreate");
+entry("shmmap");
+entry("nanosleep");
+entry("clock_gettime");
@@ -0,0 +1,41 @@
+// Time getpid() and uptime(), which read pages the kernel
+// maps into every process, against _getpid() and _uptime(),
+// the system calls that trap for the same answers.
+// usage: usysbench [calls]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+static void
+bench(char *name, int (*f)(void), int n)
+{
+  int i, t0, t;
+  volatile int x;
+
+  t0 = _uptime();
+  for(i = 0; i < n; i++)
+    x = f();
+  (void)x;
+  t = _uptime() - t0;
+  printf("%s: %d calls in %d ticks\n", name, n, t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n;
+
+  n = 1000000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(getpid() != _getpid()){
+    fprintf(2, "usysbench: getpid() %d but _getpid() %d\n", getpid(), _getpid());
+    exit(1);
+  }
+  bench("getpid", getpid, n);
+  bench("_getpid", _getpid, n);
+  bench("uptime", uptime, n);
+  bench("_uptime", _uptime, n);
+  exit(0);
+}
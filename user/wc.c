@@ -37,6 +37,7 @@ main(int argc, char *argv[])
 {
   int fd, i;
 
+  setvbuf(1, _IOFBF);
   if(argc <= 1){
     wc(0, "");
     exit(0);